@@ -0,0 +1,332 @@
+#include <HD44780CG.h>
+#include <HD44780FB.h>
+
+/*
+ * HD44780CG.c
+ *
+ *A glyph cache for the 8 custom character slots of the
+ *HD44780 CGRAM. Glyphs (8 bytes, one per pixel row, 5
+ *bits each) are looked up by a hash of their contents
+ *and given a slot on demand, the least recently used
+ *slot being replaced when they're all taken. Slots
+ *needing new contents are uploaded together, using the
+ *CGRAM address auto increment so only one address
+ *instruction is needed per block of slots.
+ *
+ *Slots can also be given to animations, each frame
+ *step then rewrites just the slot's 8 bytes and every
+ *character showing it changes at once.
+ *
+ *The code is released under the MIT License, see
+ *HD44780LIB.c for the full license text.
+ */
+
+#ifdef H_USE_CG
+
+//Slot flags
+#define CG_Used		0x01
+#define CG_Pinned	0x02
+#define CG_Upload	0x04
+#define CG_Own		0x08
+
+//Per slot state: contents hash, a copy of the glyph,
+//last use time (for LRU) and flags.
+typedef struct{
+	uint32_t Hash;
+	uint8_t Glyph[8];
+	uint16_t Used;
+	uint8_t Flags;
+} CGSlot;
+
+static CGSlot CGSlots[H_CGSlots];
+
+//Use counter, incremented on every lookup.
+static uint16_t CGClock = 0;
+
+//Slots whose glyph has been replaced.
+uint8_t CGStaleMask = 0;
+
+//Animation playing in each slot, and a flag per slot
+//set by CGAnimTick when the next frame is due. The
+//flags are bytes so the tick and CGUpload can share
+//them without disabling interrupts.
+static H_Anim* CGAnims[H_CGSlots];
+static volatile uint8_t CGFrameDue[H_CGSlots];
+
+//Empty the cache, call this after H_HWInit.
+void CGInit(void){
+	uint8_t Cnt;
+
+	for(Cnt = 0; Cnt<H_CGSlots; Cnt++){
+		CGSlots[Cnt].Flags = 0;
+		CGSlots[Cnt].Used = 0;
+		CGAnims[Cnt] = 0;
+		CGFrameDue[Cnt] = 0;
+	}
+
+	CGClock = 0;
+	CGStaleMask = 0;
+}
+
+//FNV-1a hash of the 8 glyph rows. Only the 5 pixel
+//bits of each row are used.
+static uint32_t CGHash(const uint8_t* Glyph){
+	uint32_t Hash = 2166136261UL;
+	uint8_t Cnt;
+
+	for(Cnt = 0; Cnt<8; Cnt++){
+		Hash ^= Glyph[Cnt]&0x1F;
+		Hash *= 16777619UL;
+	}
+
+	return Hash;
+}
+
+//Compare a glyph with the copy held in a slot.
+static uint8_t CGSame(const CGSlot* S, const uint8_t* Glyph){
+	uint8_t Cnt;
+
+	for(Cnt = 0; Cnt<8; Cnt++){
+		if(S->Glyph[Cnt] != (Glyph[Cnt]&0x1F)) return 0;
+	}
+
+	return 1;
+}
+
+//Pick a free slot, otherwise the least recently used
+//unpinned one, and set it up for a new glyph. Ages are
+//measured from the clock so the counter can wrap.
+//Returns the slot or 0xFF if every slot is pinned.
+static uint8_t CGTake(const uint8_t* Glyph){
+	uint8_t Cnt, Slot = 0xFF;
+	uint16_t Oldest = 0xFFFF;
+
+	for(Cnt = 0; Cnt<H_CGSlots; Cnt++){
+		if(!(CGSlots[Cnt].Flags&CG_Used)){
+			Slot = Cnt;
+			break;
+		}
+		if(CGSlots[Cnt].Flags&CG_Pinned) continue;
+		if((uint16_t)(CGClock-CGSlots[Cnt].Used)>(uint16_t)(CGClock-Oldest) || Slot == 0xFF){
+			Oldest = CGSlots[Cnt].Used;
+			Slot = Cnt;
+		}
+	}
+
+	if(Slot == 0xFF) return Slot;
+
+	//Any character on screen using this slot will now
+	//show the new glyph.
+	if(CGSlots[Slot].Flags&CG_Used) CGStaleMask |= 1<<Slot;
+
+	for(Cnt = 0; Cnt<8; Cnt++){
+		CGSlots[Slot].Glyph[Cnt] = Glyph[Cnt]&0x1F;
+	}
+	CGSlots[Slot].Used = CGClock;
+	CGSlots[Slot].Flags = CG_Used|CG_Upload;
+
+	return Slot;
+}
+
+//Find the slot holding a glyph, loading it into a free
+//or the least recently used (unpinned) slot if it isn't
+//cached. Returns the character code to print the glyph
+//with, or -1 if every slot is pinned. New glyphs only
+//reach the display on the next CGUpload!
+int8_t CGGet(const uint8_t* Glyph){
+	uint32_t Hash = CGHash(Glyph);
+	uint8_t Cnt, Slot;
+
+	CGClock++;
+
+	//Cache hit? Claimed slots change under the hash so
+	//they're never matched.
+	for(Cnt = 0; Cnt<H_CGSlots; Cnt++){
+		if((CGSlots[Cnt].Flags&(CG_Used|CG_Own)) == CG_Used && CGSlots[Cnt].Hash == Hash
+		   && CGSame(&CGSlots[Cnt], Glyph)){
+			CGSlots[Cnt].Used = CGClock;
+			return H_CGCode(Cnt);
+		}
+	}
+
+	Slot = CGTake(Glyph);
+	if(Slot == 0xFF) return -1;
+
+	CGSlots[Slot].Hash = Hash;
+
+	return H_CGCode(Slot);
+}
+
+//Claim a slot for glyphs that will be changed in place
+//(animations, the canvas), loaded with Glyph to start
+//with. The slot is pinned and never shared through
+//CGGet until CGRelease. Returns the character code, or
+//-1 if every slot is pinned.
+int8_t CGClaim(const uint8_t* Glyph){
+	uint8_t Slot;
+
+	CGClock++;
+	Slot = CGTake(Glyph);
+	if(Slot == 0xFF) return -1;
+
+	CGSlots[Slot].Flags |= CG_Pinned|CG_Own;
+
+	return H_CGCode(Slot);
+}
+
+//Change the glyph of a claimed slot, sent on the next
+//CGUpload.
+void CGSetGlyph(char C, const uint8_t* Glyph){
+	uint8_t Row;
+
+	if(!H_CGIsCode(C) || !(CGSlots[C&7].Flags&CG_Own)) return;
+
+	for(Row = 0; Row<8; Row++){
+		CGSlots[C&7].Glyph[Row] = Glyph[Row]&0x1F;
+	}
+	CGSlots[C&7].Flags |= CG_Upload;
+}
+
+//Give a claimed slot back to the cache. Characters
+//showing it keep their glyph until the slot is reused.
+//The slot stays in use, holding its last glyph like any
+//cached one, so reusing it marks it stale.
+void CGRelease(char C){
+	if(!H_CGIsCode(C) || !(CGSlots[C&7].Flags&CG_Own)) return;
+
+	CGAnims[C&7] = 0;
+	CGSlots[C&7].Hash = CGHash(CGSlots[C&7].Glyph);
+	CGSlots[C&7].Flags &= ~(CG_Pinned|CG_Own);
+}
+
+//Pin (Pin = 1) or unpin (Pin = 0) the slot of a
+//character code so it's never replaced.
+void CGPin(char C, uint8_t Pin){
+	if(!H_CGIsCode(C)) return;
+
+	if(Pin) CGSlots[C&7].Flags |= CG_Pinned;
+	else CGSlots[C&7].Flags &= ~CG_Pinned;
+}
+
+//Send the glyphs loaded since the last upload to the
+//CGRAM. Consecutive slots are sent as one block, the
+//CGRAM address incrementing after each row.
+void CGUpload(void){
+	uint8_t Slot, Row, Next = 0xFF;
+	const uint8_t* Frame;
+	H_Anim* A;
+
+	for(Slot = 0; Slot<H_CGSlots; Slot++){
+		//Load the next frame of animated slots.
+		A = CGAnims[Slot];
+		if(CGFrameDue[Slot] && A){
+			CGFrameDue[Slot] = 0;
+			Frame = A->Frames[A->Frame];
+			for(Row = 0; Row<8; Row++){
+				CGSlots[Slot].Glyph[Row] = Frame[Row]&0x1F;
+			}
+			CGSlots[Slot].Flags |= CG_Upload;
+		}
+
+		if(!(CGSlots[Slot].Flags&CG_Upload)) continue;
+
+		if(Slot != Next) H_Put(H_SetCGRAMAdd|(Slot<<3), 0);
+
+		for(Row = 0; Row<8; Row++){
+			H_Put(CGSlots[Slot].Glyph[Row], 1);
+		}
+
+		CGSlots[Slot].Flags &= ~CG_Upload;
+		Next = Slot+1;
+	}
+}
+
+//Start an animation of Count frames, each shown for
+//FrameMs. The animation gets a slot to itself (pinned
+//until CGAnimStop) and the character code returned can
+//be printed anywhere it should appear. Returns -1 if
+//every slot is pinned.
+int8_t CGAnimStart(H_Anim* A, const uint8_t (*Frames)[8], uint8_t Count, uint16_t FrameMs){
+	int8_t C;
+
+	if(!Count) return -1;
+
+	A->Frames = Frames;
+	A->Count = Count;
+	A->Frame = 0;
+	A->FrameMs = FrameMs;
+	A->Ms = 0;
+
+	C = CGClaim(Frames[0]);
+	if(C<0) return -1;
+
+	CGFrameDue[C&7] = 0;
+	CGAnims[C&7] = A;
+
+	return C;
+}
+
+//Stop the animation using a character code and free
+//its slot. Characters showing it keep the last frame
+//until the slot is reused.
+void CGAnimStop(char C){
+	if(H_CGIsCode(C) && CGAnims[C&7]) CGRelease(C);
+}
+
+//Step the animations, call this every 1ms. From the
+//0.5ms SysTick handler in main.c, that's every other
+//interrupt (alongside MSec++), like FBBlinkTick.
+//Frames that are due are only flagged here, CGUpload
+//sends them so the display is never written from the
+//interrupt.
+void CGAnimTick(void){
+	uint8_t Slot;
+	H_Anim* A;
+
+	for(Slot = 0; Slot<H_CGSlots; Slot++){
+		A = CGAnims[Slot];
+		if(!A) continue;
+
+		if(++A->Ms>=A->FrameMs){
+			A->Ms = 0;
+			A->Frame = A->Frame+1<A->Count ? A->Frame+1 : 0;
+			CGFrameDue[Slot] = 1;
+		}
+	}
+}
+
+//Check whether a character is a custom character whose
+//glyph has been replaced since the last CGStaleClear.
+uint8_t CGIsStale(char C){
+	return H_CGIsCode(C) && (CGStaleMask&(1<<(C&7)));
+}
+
+//Forget which slots have been replaced, call this once
+//the stale characters have been redrawn.
+void CGStaleClear(void){
+	CGStaleMask = 0;
+}
+
+//Find the characters on screen that now show the wrong
+//glyph because their slot has been replaced. Up to Max
+//cell numbers ((Y-1)*H_XSize+X) are written to Cells
+//and the number found is returned. Cells invalidated
+//since they were last sent are left out, the next
+//flush sends them anyway. Needs the framebuffer
+//(H_USE_FB) to know what's on screen, otherwise 0 is
+//returned.
+uint8_t CGStaleCells(uint8_t* Cells, uint8_t Max){
+	uint8_t Cnt = 0;
+#ifdef H_USE_FB
+	uint8_t Cell;
+
+	if(!CGStaleMask) return 0;
+
+	for(Cell = 0; Cell<H_XSize*H_YSize && Cnt<Max; Cell++){
+		if(FBKnown(Cell) && CGIsStale(FBSent[Cell])) Cells[Cnt++] = Cell;
+	}
+#endif
+	return Cnt;
+}
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef HD44780CG_H
+#define HD44780CG_H
+
+#include <HD44780LIB.h>
+
+//CGRAM glyph cache. Uncomment H_USE_CG to share the 8
+//custom character slots of the HD44780 between any
+//number of glyphs. CGGet finds (or loads) a glyph and
+//returns the character code to print it with, least
+//recently used glyphs being replaced when all slots
+//are taken.
+//#define H_USE_CG
+
+//Number of CGRAM slots for 5x8 characters.
+#define H_CGSlots 8
+
+//Custom characters are printed with codes 8 to 15
+//(which show the same glyphs as 0 to 7) so they can be
+//used in strings without being taken as the null
+//terminator.
+#define H_CGCode(Slot) (8+(Slot))
+#define H_CGIsCode(C) (((uint8_t)(C)&0xF0) == 0)
+
+//Animation state: frame table (8 bytes per frame, in
+//flash), number of frames, the frame shown, the time
+//each frame is shown for in ms and the time elapsed.
+typedef struct{
+	const uint8_t (*Frames)[8];
+	uint8_t Count;
+	volatile uint8_t Frame;
+	uint16_t FrameMs;
+	uint16_t Ms;
+} H_Anim;
+
+#ifdef H_USE_CG
+//Slots whose glyph has been replaced since the last
+//CGStaleClear, one bit per slot.
+extern uint8_t CGStaleMask;
+
+//Glyph cache functions
+void CGInit(void);
+int8_t CGGet(const uint8_t*);
+void CGPin(char, uint8_t);
+int8_t CGClaim(const uint8_t*);
+void CGSetGlyph(char, const uint8_t*);
+void CGRelease(char);
+void CGUpload(void);
+uint8_t CGIsStale(char);
+void CGStaleClear(void);
+uint8_t CGStaleCells(uint8_t*, uint8_t);
+
+//Animation functions
+int8_t CGAnimStart(H_Anim*, const uint8_t (*)[8], uint8_t, uint16_t);
+void CGAnimStop(char);
+void CGAnimTick(void);
+#endif
+
+#endif
@@ -0,0 +1,177 @@
+#include <HD44780DMA.h>
+
+/*
+ * HD44780DMA.c
+ *
+ *A waveform engine for the HD44780 library. Instructions
+ *and characters are compiled into a buffer of GPIO BSRR
+ *words covering the data nibbles, RS and the enable
+ *edges, including idle words to cover the execution time
+ *of each instruction. TIM2 update events then trigger
+ *DMA1 channel 2 to copy one word at a time into the
+ *BSRR register of HD44780_GPIO, so a whole screen update
+ *happens without the CPU. The end of the transfer is
+ *signalled by the DMA transfer complete interrupt.
+ *
+ *The building functions don't touch the hardware, so the
+ *generated word stream is checked on the host (see
+ *HostTest), words and timing both.
+ *
+ *The code is released under the MIT License, see
+ *HD44780LIB.c for the full license text.
+ */
+
+#ifdef H_USE_DMA
+
+#ifdef H_BUS8B
+#error "The DMA waveform engine only supports the 4bit bus"
+#endif
+
+//Waveform buffer and current length in words.
+uint32_t H_DMABuf[H_DMABufSize];
+volatile uint16_t H_DMALen = 0;
+
+//Set whilst a transfer is running.
+volatile uint8_t H_DMABusy = 0;
+
+//Transfer complete callback, 0 if unused.
+void (*H_DMADone)(void) = 0;
+
+//Setup TIM2 to generate an update event (and DMA
+//request) every H_DMATickUs and DMA1 channel 2 to copy
+//32bit words from the waveform buffer to the BSRR
+//register of the HD44780 port.
+void H_DMAInit(void){
+	RCC_AHBPeriphClockCmd(RCC_AHBPeriph_DMA1, ENABLE);
+	RCC_APB1PeriphClockCmd(RCC_APB1Periph_TIM2, ENABLE);
+
+	//1MHz timer clock, overflowing every H_DMATickUs.
+	//The prescaler is only loaded on an update, so one
+	//is forced (before DMA requests are enabled) or the
+	//first request would come after H_DMATickUs core
+	//clocks.
+	TIM2->CR1 = 0;
+	TIM2->PSC = (SystemCoreClock/1000000)-1;
+	TIM2->ARR = H_DMATickUs-1;
+	TIM2->EGR = TIM_EGR_UG;
+	TIM2->SR = 0;
+	TIM2->DIER = TIM_DIER_UDE;
+
+	//Memory to peripheral, 32bit both sides, memory
+	//address incremented, interrupt on completion.
+	DMA1_Channel2->CCR = 0;
+	DMA1_Channel2->CPAR = (uint32_t)&HD44780_GPIO->BSRR;
+	DMA1_Channel2->CCR = DMA_CCR_DIR|DMA_CCR_MINC|DMA_CCR_PSIZE_1|
+						 DMA_CCR_MSIZE_1|DMA_CCR_TCIE;
+
+	NVIC_EnableIRQ(DMA1_Channel2_3_IRQn);
+}
+
+//Empty the waveform buffer, ready for a new sequence.
+void H_DMAClear(void){
+	H_DMALen = 0;
+}
+
+//Add the words for one nibble: data and RS, enable
+//high, enable low. The enable pin(s) are those of the
+//display(s) selected when the buffer is built. The
+//data is latched on the falling edge of the enable
+//pin.
+static void H_DMANib(uint8_t Nib, uint32_t RSWord){
+	H_DMABuf[H_DMALen++] = H_NibBSRR(Nib)|RSWord;
+	H_DMABuf[H_DMALen++] = H_ENSel;
+	H_DMABuf[H_DMALen++] = (uint32_t)H_ENSel<<16;
+}
+
+//Add an instruction (RD = 0) or data byte (RD = 1)
+//to the waveform buffer, followed by enough idle
+//words (0 doesn't change any pins) for the HD44780 to
+//execute it before the next enable pulse. The byte is
+//tracked (H_Track) as it's added, the buffer being
+//expected to be sent. Returns -1 if the buffer is
+//full.
+int8_t H_DMAAdd(uint8_t Data, uint8_t RD){
+	uint32_t RSWord = RD?(uint32_t)H_RS:((uint32_t)H_RS<<16);
+	uint16_t Idle, Cnt;
+
+	//The next enable pulse rises two ticks after the
+	//start of the next byte, so that time is already
+	//covered.
+	Idle = (H_ExecUs(Data, RD)+H_DMATickUs-1)/H_DMATickUs;
+	if(Idle>2) Idle-=2;
+	else Idle = 0;
+
+	if(H_DMALen+6+Idle>H_DMABufSize) return -1;
+
+	H_Track(Data, RD);
+	H_DMANib(Data>>4, RSWord);
+	H_DMANib(Data, RSWord);
+
+	for(Cnt = 0; Cnt<Idle; Cnt++){
+		H_DMABuf[H_DMALen++] = 0;
+	}
+
+	return 0;
+}
+
+//Add a string at position X, Y with the same checks
+//and return values as PStr. Returns -4 if the buffer
+//can't hold the whole string.
+int8_t H_DMAStr(const char* S, uint8_t X, uint8_t Y){
+	uint8_t Cnt, StrLen;
+
+	StrLen = Strlen(S);
+
+	if(StrLen>(H_XSize)) return -3;
+	if(X>(H_XSize-StrLen)) return -1;
+	if(!H_RowOK(Y)) return -2;
+
+	if(H_DMAAdd(H_SetDDRamAdd|H_CellAdd(X, Y), 0)) return -4;
+
+	for(Cnt = 0; Cnt<StrLen; Cnt++){
+		if(H_DMAAdd(S[Cnt], 1)) return -4;
+	}
+
+	return X+StrLen;
+}
+
+//Start clocking the waveform buffer out to the
+//display. Returns -1 if a transfer is already running
+//or the buffer is empty.
+int8_t H_DMAStart(void){
+	if(H_DMABusy || H_DMALen == 0) return -1;
+
+	H_DMABusy = 1;
+
+	DMA1_Channel2->CMAR = (uint32_t)H_DMABuf;
+	DMA1_Channel2->CNDTR = H_DMALen;
+	DMA1_Channel2->CCR |= DMA_CCR_EN;
+
+	TIM2->CNT = 0;
+	TIM2->CR1 |= TIM_CR1_CEN;
+
+	return 0;
+}
+
+//Wait for the current transfer to complete.
+void H_DMAWait(void){
+	while(H_DMABusy) H_Idle();
+}
+
+//Transfer complete interrupt, stops the timer and
+//the DMA channel. The last words of the buffer are
+//idle time so the display has finished executing
+//the last instruction by now.
+void DMA1_Channel2_3_IRQHandler(void){
+	if(DMA1->ISR & DMA_ISR_TCIF2){
+		DMA1->IFCR = DMA_IFCR_CTCIF2;
+
+		TIM2->CR1 &= ~TIM_CR1_CEN;
+		DMA1_Channel2->CCR &= ~DMA_CCR_EN;
+
+		H_DMABusy = 0;
+		if(H_DMADone) H_DMADone();
+	}
+}
+
+#endif
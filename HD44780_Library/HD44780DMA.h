@@ -0,0 +1,50 @@
+#ifndef HD44780DMA_H
+#define HD44780DMA_H
+
+#include <HD44780LIB.h>
+
+//Timer + DMA waveform engine. Uncomment H_USE_DMA to
+//compile strings and instructions into a buffer of
+//GPIO BSRR words which TIM2 then clocks out to the
+//HD44780 port through DMA1 channel 2, leaving the CPU
+//free during screen updates. Only the 4bit bus on
+//HD44780_GPIO is supported. Bytes are tracked
+//(H_Track) as they're added, so each buffer built
+//should be sent once.
+//#define H_USE_DMA
+
+//Size of the waveform buffer in 32bit BSRR words.
+//With the default H_ExecMargin, each character takes
+//9 words, other instructions 8 and a clear or return
+//home 172 words.
+#define H_DMABufSize 256
+
+//Time between BSRR words in us, this is also the
+//width of the enable pulse.
+#define H_DMATickUs 10
+
+#ifdef H_USE_DMA
+//Waveform buffer, its length and the busy flag
+//(cleared by the transfer complete interrupt).
+extern uint32_t H_DMABuf[H_DMABufSize];
+extern volatile uint16_t H_DMALen;
+extern volatile uint8_t H_DMABusy;
+
+//Optional function called from the transfer complete
+//interrupt.
+extern void (*H_DMADone)(void);
+
+//Hardware setup
+void H_DMAInit(void);
+
+//Waveform building functions
+void H_DMAClear(void);
+int8_t H_DMAAdd(uint8_t, uint8_t);
+int8_t H_DMAStr(const char*, uint8_t, uint8_t);
+
+//Transfer control
+int8_t H_DMAStart(void);
+void H_DMAWait(void);
+#endif
+
+#endif
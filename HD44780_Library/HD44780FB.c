@@ -0,0 +1,607 @@
+#include <HD44780FB.h>
+
+/*
+ * HD44780FB.c
+ *
+ *A shadow framebuffer for the HD44780 library. Drawing
+ *happens in RAM and only the characters that have
+ *changed since the last flush are sent to the display,
+ *typically cutting the bus traffic of a screen redraw
+ *by an order of magnitude.
+ *
+ *Parts of the application can each own a region of the
+ *screen, drawing relative to it with clipping. Regions
+ *are composed into the same framebuffer, the highest
+ *region showing where they overlap.
+ *
+ *The code is released under the MIT License, see
+ *HD44780LIB.c for the full license text.
+ */
+
+#ifdef H_USE_FB
+
+//Front buffer (what the application wants on screen,
+//sent by the flush), back buffer (what the print
+//functions draw into) and what the display holds.
+//Cell index is (Y-1)*H_XSize+X. Single buffered, the
+//front and back buffers are the same.
+static char FBBufA[H_FBCells], FBBufB[H_FBCells];
+char* volatile FB = FBBufA;
+char* FBBack = FBBufA;
+char FBSent[H_FBCells];
+
+//Cells drawn into the back buffer since the last
+//commit, one bit per cell.
+static uint8_t FBDirty[(H_FBCells+7)/8];
+
+//Cells where FBSent isn't known to match the display
+//(see FBInvalidate), one bit per cell.
+static uint8_t FBUnknown[(H_FBCells+7)/8];
+
+//Registered regions and the region shown in each
+//cell (its ID, 0 where no region covers the cell).
+static FBRegion* FBRegs[H_FBRegions];
+static uint8_t FBOwner[H_FBCells];
+
+//Cell attributes (FB_Blink) and the alternate
+//characters shown in the second half of the blink.
+static uint8_t FBAttr[H_FBCells];
+static char FBAlt[H_FBCells];
+
+//Blink phase clock, shared by every blinking cell,
+//and the counter used by FBBlinkTick.
+volatile uint8_t FBPhase = 0;
+volatile uint16_t FBBlinkMs = 500;
+static uint16_t FBBlinkCnt = 0;
+
+//Current print position in the framebuffer.
+static uint8_t FBCur = 0;
+
+//Flush planner costs of a DDRAM address instruction
+//and a data write, in us. Set from the execution time
+//table by FBInit, change them if the transport has
+//other costs.
+uint16_t FBCostCmd = 40, FBCostData = 45;
+
+//Bytes sent per FBTick call.
+volatile uint16_t FBTickBudget = 4;
+
+//Display shift the framebuffer was last sent with.
+static uint8_t FBShiftSeen = 0;
+
+//Setup the framebuffer, call this after H_HWInit. The
+//display has just been cleared so both copies are
+//filled with spaces.
+void FBInit(void){
+	uint8_t Cnt;
+
+	for(Cnt = 0; Cnt<H_FBCells; Cnt++){
+		FBBufA[Cnt] = ' ';
+		FBBufB[Cnt] = ' ';
+		FBSent[Cnt] = ' ';
+	}
+
+	for(Cnt = 0; Cnt<sizeof(FBDirty); Cnt++){
+		FBDirty[Cnt] = 0;
+		FBUnknown[Cnt] = 0;
+	}
+
+	for(Cnt = 0; Cnt<H_FBCells; Cnt++){
+		FBOwner[Cnt] = 0;
+		FBAttr[Cnt] = 0;
+		FBAlt[Cnt] = ' ';
+	}
+
+	for(Cnt = 0; Cnt<H_FBRegions; Cnt++){
+		FBRegs[Cnt] = 0;
+	}
+
+	FB = FBBufA;
+	FBBack = FBBufA;
+	FBCur = 0;
+	FBShiftSeen = H_ShiftOff;
+
+	FBCostCmd = H_ExecUs(H_SetDDRamAdd, 0);
+	FBCostData = H_ExecUs(' ', 1);
+}
+
+//Draw a character into a back buffer cell, noting
+//which cells have been drawn for the next commit.
+static void FBDraw(uint8_t Cell, char C){
+	if(FBBack[Cell] == C) return;
+
+	FBBack[Cell] = C;
+	FBDirty[Cell>>3] |= 1<<(Cell&7);
+}
+
+//Fill the framebuffer with spaces, the framebuffer
+//version of ClrDisp.
+void FBClear(void){
+	uint8_t Cnt;
+
+	for(Cnt = 0; Cnt<H_FBCells; Cnt++){
+		FBDraw(Cnt, ' ');
+	}
+}
+
+//Switch between single buffering, where drawing is
+//sent by the next flush, and double buffering, where
+//drawing goes into a separate back buffer and is only
+//sent once FBCommit has been called.
+void FBSetDouble(uint8_t Double){
+	uint8_t Cnt;
+
+	FBCommit();
+
+	if(Double){
+		FBBack = (FB == FBBufA)?FBBufB:FBBufA;
+		for(Cnt = 0; Cnt<H_FBCells; Cnt++){
+			FBBack[Cnt] = FB[Cnt];
+		}
+	}
+	else{
+		FBBack = FB;
+	}
+}
+
+//Publish the back buffer, the following flushes send
+//it to the display. The buffers are swapped with a
+//single pointer store, which is atomic, so this is
+//safe whilst a flush is running from an interrupt (each
+//flush call sends from one committed frame). Only the
+//cells drawn since the last commit are then copied into
+//the new back buffer, so drawing carries on from the
+//frame just published.
+void FBCommit(void){
+	uint8_t Cnt, Cell;
+	char* Front = FBBack;
+
+	if(FBBack != FB){
+		FBBack = FB;
+		FB = Front;
+
+		for(Cnt = 0; Cnt<sizeof(FBDirty); Cnt++){
+			if(!FBDirty[Cnt]) continue;
+
+			for(Cell = Cnt*8; Cell<Cnt*8+8 && Cell<H_FBCells; Cell++){
+				if(FBDirty[Cnt]&(1<<(Cell&7))) FBBack[Cell] = Front[Cell];
+			}
+		}
+	}
+
+	for(Cnt = 0; Cnt<sizeof(FBDirty); Cnt++){
+		FBDirty[Cnt] = 0;
+	}
+}
+
+//The character a cell shows for a blink phase, the
+//alternate character in the second half of the blink
+//of blinking cells.
+static char FBShow(const char* Buf, uint8_t Cell, uint8_t Phase){
+	if(Phase && (FBAttr[Cell]&FB_Blink)) return FBAlt[Cell];
+	return Buf[Cell];
+}
+
+//Set the attributes (FB_Blink or 0) and alternate
+//character of W cells starting at X, Y. Blinking cells
+//swap between their character and the alternate one
+//(e.g. ' ' to blink an alarm on and off) as the blink
+//phase changes, the flush only resending those cells.
+void FBSetAttr(uint8_t X, uint8_t Y, uint8_t W, uint8_t Attr, char Alt){
+	uint8_t Cell;
+
+	if(!H_RowOK(Y)) return;
+
+	for(; W>0 && X<H_XSize; W--, X++){
+		Cell = (Y-1)*H_XSize+X;
+		FBAttr[Cell] = Attr;
+		FBAlt[Cell] = Alt;
+	}
+}
+
+//Set the alternate characters of the cells starting
+//at X, Y from a string, to swap between two texts.
+void FBSetAltStr(uint8_t X, uint8_t Y, const char* S){
+	if(!H_RowOK(Y)) return;
+
+	for(; *S && X<H_XSize; S++, X++){
+		FBAlt[(Y-1)*H_XSize+X] = *S;
+	}
+}
+
+//Blink phase clock, call this every millisecond. The
+//SysTick interrupt in main.c runs every 0.5ms, so call
+//it there only when MState is 1 (where MSec counts).
+//The phase changes every FBBlinkMs calls, the next
+//flush then sends the blinking cells with the other
+//phase along with any other changes.
+void FBBlinkTick(void){
+	if(++FBBlinkCnt>=FBBlinkMs){
+		FBBlinkCnt = 0;
+		FBPhase ^= 1;
+	}
+}
+
+//Forget what the display holds, the next flush will
+//send every character. Use this if the display has
+//been written to without going through the
+//framebuffer.
+void FBInvalidate(void){
+	uint8_t Cnt;
+
+	//FBSent keeps the characters last sent, only the
+	//cells are marked unknown.
+	for(Cnt = 0; Cnt<sizeof(FBUnknown); Cnt++){
+		FBUnknown[Cnt] = 0xFF;
+	}
+}
+
+//Check whether FBSent holds what the display shows in
+//a cell, which isn't the case after FBInvalidate until
+//the cell has been sent again.
+uint8_t FBKnown(uint8_t Cell){
+	return !(FBUnknown[Cell>>3]&(1<<(Cell&7)));
+}
+
+//Record a character sent to a cell.
+static void FBSetSent(uint8_t Cell, char C){
+	FBSent[Cell] = C;
+	FBUnknown[Cell>>3] &= ~(1<<(Cell&7));
+}
+
+//Move the framebuffer print position to X, Y.
+void FBGoTo(uint8_t X, uint8_t Y){
+	FBCur = (Y-1)*H_XSize+X;
+}
+
+//Draw a character at the framebuffer print position.
+void FBPutC(char C){
+	if(FBCur<H_FBCells) FBDraw(FBCur++, C);
+}
+
+//Give the cells of a region to it, unless a higher
+//region already owns them. Equal Z goes to the higher
+//ID, so the owners don't depend on the order regions
+//are claimed in.
+static void FBRegionClaim(FBRegion* R){
+	uint8_t X, Y, Cell, Own;
+
+	for(Y = R->Y; Y<R->Y+R->H && Y<=H_YSize; Y++){
+		for(X = R->X; X<R->X+R->W && X<H_XSize; X++){
+			Cell = (Y-1)*H_XSize+X;
+			Own = FBOwner[Cell];
+			if(!Own || FBRegs[Own-1]->Z<R->Z || (FBRegs[Own-1]->Z == R->Z && Own<=R->ID)){
+				FBOwner[Cell] = R->ID;
+			}
+		}
+	}
+}
+
+//Register a region. Returns -1 if there's no room for
+//another region or it doesn't start on screen.
+int8_t FBRegionAdd(FBRegion* R){
+	uint8_t Cnt;
+
+	if(R->X>(H_XSize-1) || !H_RowOK(R->Y)) return -1;
+
+	for(Cnt = 0; Cnt<H_FBRegions; Cnt++){
+		if(!FBRegs[Cnt]){
+			FBRegs[Cnt] = R;
+			R->ID = Cnt+1;
+			FBRegionClaim(R);
+			return 0;
+		}
+	}
+
+	return -1;
+}
+
+//Remove a region, the regions below it get their
+//cells back. Its characters stay in the framebuffer
+//until drawn over.
+void FBRegionRemove(FBRegion* R){
+	uint8_t Cnt;
+
+	if(!R->ID || FBRegs[R->ID-1] != R) return;
+
+	FBRegs[R->ID-1] = 0;
+	R->ID = 0;
+
+	for(Cnt = 0; Cnt<H_FBCells; Cnt++){
+		FBOwner[Cnt] = 0;
+	}
+
+	//Ownership only depends on Z and ID, so the order
+	//doesn't matter.
+	for(Cnt = 0; Cnt<H_FBRegions; Cnt++){
+		if(FBRegs[Cnt]) FBRegionClaim(FBRegs[Cnt]);
+	}
+}
+
+//Draw a character at X, Y relative to a region. Returns
+//1 if it was drawn, 0 if it was clipped because it's
+//outside the region or the screen, or covered by a
+//higher region.
+static uint8_t FBRegionDraw(FBRegion* R, char C, uint8_t X, uint8_t Y){
+	uint8_t Cell;
+
+	if(X>=R->W || Y<1 || Y>R->H) return 0;
+
+	X+=R->X;
+	Y+=R->Y-1;
+	if(X>(H_XSize-1) || !H_RowOK(Y)) return 0;
+
+	Cell = (Y-1)*H_XSize+X;
+	if(FBOwner[Cell] != R->ID) return 0;
+
+	FBDraw(Cell, C);
+	return 1;
+}
+
+//Set the attributes and alternate character of the
+//cells a region shows.
+void RAttr(FBRegion* R, uint8_t Attr, char Alt){
+	uint8_t X, Y, Cell;
+
+	for(Y = R->Y; Y<R->Y+R->H && Y<=H_YSize; Y++){
+		for(X = R->X; X<R->X+R->W && X<H_XSize; X++){
+			Cell = (Y-1)*H_XSize+X;
+			if(FBOwner[Cell] != R->ID) continue;
+			FBAttr[Cell] = Attr;
+			FBAlt[Cell] = Alt;
+		}
+	}
+}
+
+//Fill a region with spaces.
+void RClear(FBRegion* R){
+	uint8_t X, Y;
+
+	for(Y = 1; Y<=R->H; Y++){
+		for(X = 0; X<R->W; X++){
+			FBRegionDraw(R, ' ', X, Y);
+		}
+	}
+}
+
+//Draw a character at X, Y relative to a region (X from
+//0, Y from 1). Returns the next X position, the
+//character being clipped if it's outside the region.
+int8_t RChar(FBRegion* R, char C, uint8_t X, uint8_t Y){
+	FBRegionDraw(R, C, X, Y);
+	return X+1;
+}
+
+//Draw a string at X, Y relative to a region. Anything
+//outside of the region is clipped rather than the
+//whole string being rejected. Returns the X position
+//after the string.
+int8_t RStr(FBRegion* R, const char* S, uint8_t X, uint8_t Y){
+	for(; *S && X<R->W; S++, X++){
+		FBRegionDraw(R, *S, X, Y);
+	}
+
+	return X;
+}
+
+//Draw a number at X, Y relative to a region, with the
+//same sign and zero padding as PNum and clipped to
+//the region. Returns the X position after the number.
+int8_t RNum(FBRegion* R, int32_t Num, uint8_t X, uint8_t Y, uint8_t Pad){
+	char Buf[10];
+	uint8_t Cnt, Len = H_UDigits(H_Mag(Num), Buf);
+
+	//Unlike PNum, 0 is drawn as a digit.
+	if(!Len) Buf[Len++] = '0';
+
+	if(Num<0) X = RChar(R, '-', X, Y);
+
+	for(; Pad>0; Pad--){
+		X = RChar(R, '0', X, Y);
+	}
+
+	for(Cnt = 0; Cnt<Len; Cnt++){
+		X = RChar(R, Buf[Cnt], X, Y);
+	}
+
+	return X;
+}
+
+//Find the framebuffer cell shown at a DDRAM address,
+//0xFF if the address isn't on screen.
+static uint8_t FBAddCell(uint8_t Add){
+	uint8_t Row;
+
+	for(Row = 0; Row<H_YSize; Row++){
+		if(Add>=H_Geo->RowAdd[Row] && Add<H_Geo->RowAdd[Row]+H_XSize){
+			return Row*H_XSize+(Add-H_Geo->RowAdd[Row]);
+		}
+	}
+
+	return 0xFF;
+}
+
+//Sort the rows into DDRAM address order so rows that
+//follow on from each other in DDRAM (rows 1 and 3 of
+//a 20x4 display) can be sent as one run.
+static void FBRowOrder(uint8_t* Order){
+	uint8_t Cnt, Pos, Row;
+
+	for(Cnt = 0; Cnt<H_YSize; Cnt++){
+		Row = Cnt;
+		for(Pos = Cnt; Pos>0 && H_Geo->RowAdd[Order[Pos-1]]>H_Geo->RowAdd[Row]; Pos--){
+			Order[Pos] = Order[Pos-1];
+		}
+		Order[Pos] = Row;
+	}
+}
+
+//Shifting the display moves what's on screen, so
+//everything has to be sent again. Checked by anything
+//comparing the framebuffer with what's been sent.
+static void FBShiftCheck(void){
+	if(H_ShiftOff != FBShiftSeen){
+		FBInvalidate();
+		FBShiftSeen = H_ShiftOff;
+	}
+}
+
+//Check whether resending the characters from address
+//Next up to (not including) Add is cheaper than a new
+//DDRAM address instruction, and that they're all on
+//screen. The address counter has to be incrementing
+//for the resent characters to land in order.
+static uint8_t FBGapOK(uint8_t Next, uint8_t Add){
+	if(Next == H_ACUnknown || Add<=Next || H_ShiftOff) return 0;
+	if(!(H_EntryMode()&H_Increment)) return 0;
+	if((uint16_t)(Add-Next)*FBCostData>FBCostCmd) return 0;
+
+	for(; Next<Add; Next++){
+		if(FBAddCell(Next) == 0xFF) return 0;
+	}
+
+	return 1;
+}
+
+//Send the characters that differ from what the display
+//holds. Each run of changed characters needs a DDRAM
+//address instruction (costing FBCostCmd) unless the
+//tracked address counter is already there. When two changed
+//characters are close, it can be cheaper to resend the
+//unchanged characters between them (FBCostData each)
+//than to set the address again. Each gap is decided on
+//its own as the choices don't affect each other, which
+//gives the cheapest plan overall. Gaps are only filled
+//when every address in between is on screen, so the
+//jump between rows (e.g. 0x0F to 0x40) always gets a
+//new address. Whilst the display is shifted, every
+//run gets its own address. The address counter after
+//each write comes from the tracked one, so decrement
+//mode gets an address for every character.
+static uint16_t FBSend(uint16_t Budget){
+	uint8_t Order[4], Row, X, Cell, Add, Fill, Next = H_DDAdd();
+	uint16_t Sent = 0, Need;
+	char* Front = FB;
+	uint8_t Phase = FBPhase;
+	char C;
+
+	FBRowOrder(Order);
+
+	for(Row = 0; Row<H_YSize; Row++){
+		for(X = 0; X<H_XSize; X++){
+			Cell = Order[Row]*H_XSize+X;
+			C = FBShow(Front, Cell, Phase);
+			if(C == FBSent[Cell] && FBKnown(Cell)) continue;
+
+			Add = H_CellAdd(X, Order[Row]+1);
+
+			//Bytes needed for this character: the gap
+			//fill or address (if the address counter
+			//isn't already here) plus the character.
+			Fill = 0;
+			Need = 1;
+			if(Add != Next){
+				if(FBGapOK(Next, Add) && Sent+(Add-Next)+1<=Budget){
+					Fill = 1;
+					Need += Add-Next;
+				}
+				else Need++;
+			}
+
+			//Out of budget, carry on next time.
+			if(Sent+Need>Budget) return Sent;
+
+			if(Fill){
+				//Resend the unchanged characters.
+				for(; Next<Add; Next++){
+					Cell = FBAddCell(Next);
+					FBSetSent(Cell, FBShow(Front, Cell, Phase));
+					H_Put(FBSent[Cell], 1);
+					Sent++;
+				}
+				Cell = Order[Row]*H_XSize+X;
+			}
+			else if(Add != Next){
+				Sent += H_SetAdd(Add);
+			}
+
+			H_Put(C, 1);
+			FBSetSent(Cell, C);
+			Next = H_DDAdd();
+			Sent++;
+		}
+	}
+
+	return Sent;
+}
+
+//Flush with the planner above. At most Budget bytes
+//are sent, so a redraw can be spread over several
+//calls to bound the time spent in each. The diff is
+//taken against what has been sent so far, so each call
+//carries on where the last one stopped (in address
+//order) and always sends the latest framebuffer
+//contents. With the entry mode display shift on, every
+//character written would shift the display, so the
+//shift is turned off for the flush and back on after,
+//the two instructions counting towards Budget. Returns
+//the number of bytes sent.
+uint16_t FBFlushN(uint16_t Budget){
+	uint8_t Mode = H_EntryMode();
+	uint16_t Sent;
+
+	//A character can need an address and a data write,
+	//any less and nothing would ever be sent.
+	if(Budget<2) Budget = 2;
+
+	FBShiftCheck();
+
+	if(!(Mode&H_DispShiftEn)) return FBSend(Budget);
+
+	if(!FBBacklog()) return 0;
+	if(Budget<4) Budget = 4;
+
+	H_Put(Mode&~H_DispShiftEn, 0);
+	Sent = FBSend(Budget-2);
+	H_Put(Mode, 0);
+
+	return Sent+2;
+}
+
+//Send everything that differs from what the display
+//holds. Returns the number of bytes sent.
+uint16_t FBFlush(void){
+	return FBFlushN(0xFFFF);
+}
+
+//Number of characters still to be sent.
+uint8_t FBBacklog(void){
+	uint8_t Cell, Cnt = 0;
+
+	FBShiftCheck();
+
+	for(Cell = 0; Cell<H_XSize*H_YSize; Cell++){
+		if(FBShow(FB, Cell, FBPhase) != FBSent[Cell] || !FBKnown(Cell)) Cnt++;
+	}
+
+	return Cnt;
+}
+
+//Worst case time in us to send the backlog, assuming
+//every character needs its own address. Use this to
+//decide when FBFlush must be called to have the
+//display up to date before a deadline.
+uint32_t FBBacklogUs(void){
+	return (uint32_t)FBBacklog()*(FBCostCmd+FBCostData);
+}
+
+//Incremental flush handler, call this periodically
+//(e.g. from the main loop or the SysTick interrupt) to
+//send up to FBTickBudget bytes per call. Don't call
+//FBFlush or write to the display directly whilst it
+//is being called from an interrupt!
+void FBTick(void){
+	FBFlushN(FBTickBudget);
+}
+
+#endif
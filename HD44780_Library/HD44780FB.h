@@ -0,0 +1,91 @@
+#ifndef HD44780FB_H
+#define HD44780FB_H
+
+#include <HD44780LIB.h>
+
+//Shadow framebuffer. Uncomment H_USE_FB to keep a copy
+//of the display contents in RAM. With the print target
+//set to H_TargetFB, PStr, PChar, PNum, PNumF and
+//ClrDisp only update the framebuffer, FBFlush then
+//sends just the characters that differ from what the
+//display holds. With double buffering (FBSetDouble),
+//drawing only reaches the display after FBCommit.
+//#define H_USE_FB
+
+//Largest number of characters supported, enough for
+//20x4 and 40x2 displays.
+#define H_FBCells 80
+
+//Cell attributes, blinking cells swap between their
+//character and an alternate one with the blink phase.
+#define FB_Blink 0x01
+
+//Largest number of regions.
+#define H_FBRegions 8
+
+//A rectangular region of the screen, owned by one
+//part of the application. X and Y are the position of
+//its top left character (X from 0, Y from 1 as with
+//PStr), W and H its size. Where regions overlap, the
+//one with the highest Z is shown, or with equal Z the
+//one with the highest ID. ID is set by FBRegionAdd.
+typedef struct{
+	uint8_t X, Y;
+	uint8_t W, H;
+	uint8_t Z;
+	uint8_t ID;
+} FBRegion;
+
+#ifdef H_USE_FB
+//Front buffer (sent to the display), back buffer
+//(drawn into) and what the display currently holds,
+//one byte per character, row by row.
+extern char* volatile FB;
+extern char* FBBack;
+extern char FBSent[H_FBCells];
+
+//Flush planner costs in us.
+extern uint16_t FBCostCmd, FBCostData;
+
+//Setup and drawing
+void FBInit(void);
+void FBClear(void);
+void FBInvalidate(void);
+uint8_t FBKnown(uint8_t);
+void FBGoTo(uint8_t, uint8_t);
+void FBPutC(char);
+
+//Double buffering
+void FBSetDouble(uint8_t);
+void FBCommit(void);
+
+//Regions, drawing is relative to the region and
+//clipped to it (and to the parts of it not covered by
+//higher regions).
+int8_t FBRegionAdd(FBRegion*);
+void FBRegionRemove(FBRegion*);
+void RClear(FBRegion*);
+void RAttr(FBRegion*, uint8_t, char);
+int8_t RChar(FBRegion*, char, uint8_t, uint8_t);
+int8_t RStr(FBRegion*, const char*, uint8_t, uint8_t);
+int8_t RNum(FBRegion*, int32_t, uint8_t, uint8_t, uint8_t);
+
+//Attributes and the blink phase clock
+extern volatile uint8_t FBPhase;
+extern volatile uint16_t FBBlinkMs;
+void FBSetAttr(uint8_t, uint8_t, uint8_t, uint8_t, char);
+void FBSetAltStr(uint8_t, uint8_t, const char*);
+void FBBlinkTick(void);
+
+//Bytes sent per FBTick call.
+extern volatile uint16_t FBTickBudget;
+
+//Sending to the display
+uint16_t FBFlush(void);
+uint16_t FBFlushN(uint16_t);
+void FBTick(void);
+uint8_t FBBacklog(void);
+uint32_t FBBacklogUs(void);
+#endif
+
+#endif
@@ -0,0 +1,372 @@
+#include <HD44780GFX.h>
+
+/*
+ * HD44780GFX.c
+ *
+ *Graphics made from custom characters: big digits
+ *drawn from a few shared segment glyphs, bar graphs
+ *with a step per pixel column and a small pixel canvas
+ *made of a block of custom characters. The glyphs go
+ *through the CGRAM cache (HD44780CG.c) so they can be
+ *used alongside other custom characters.
+ *
+ *The code is released under the MIT License, see
+ *HD44780LIB.c for the full license text.
+ */
+
+#ifdef H_USE_CG
+
+//Segment glyphs: a bar at the top of the character, a
+//bar at the bottom, and both.
+static const uint8_t BigSegs[3][8] = {
+	{0x1F, 0x1F, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+	{0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1F, 0x1F},
+	{0x1F, 0x1F, 0x00, 0x00, 0x00, 0x00, 0x1F, 0x1F}
+};
+
+//Big characters as 3x2 cells, top row first. 0 to 2
+//are the segment glyphs above, 3 the full block in the
+//character ROM (0xFF) and 4 a space.
+static const uint8_t BigMap[12][6] = {
+	{3, 0, 3, 3, 1, 3},	//0
+	{0, 3, 4, 1, 3, 1},	//1
+	{2, 2, 3, 3, 1, 1},	//2
+	{2, 2, 3, 1, 1, 3},	//3
+	{3, 1, 3, 4, 4, 3},	//4
+	{3, 2, 2, 1, 1, 3},	//5
+	{3, 2, 2, 3, 1, 3},	//6
+	{0, 0, 3, 4, 4, 3},	//7
+	{3, 2, 3, 3, 1, 3},	//8
+	{3, 2, 3, 1, 1, 3},	//9
+	{1, 1, 1, 4, 4, 4},	//-
+	{4, 4, 4, 4, 4, 4}	//Space
+};
+
+//Character codes for the BigMap cells, the segment
+//codes are filled in by BigFontInit.
+static char BigChars[5] = {' ', ' ', ' ', (char)0xFF, ' '};
+
+//Load the segment glyphs into the CGRAM. They're
+//pinned so the cache never replaces them and uploaded
+//straight away, so this only needs calling once after
+//CGInit. Returns -1 if there aren't 3 free slots.
+int8_t BigFontInit(void){
+	uint8_t Cnt;
+	int8_t C;
+
+	for(Cnt = 0; Cnt<3; Cnt++){
+		C = CGGet(BigSegs[Cnt]);
+		if(C<0) return -1;
+
+		CGPin(C, 1);
+		BigChars[Cnt] = C;
+	}
+
+	CGUpload();
+	return 0;
+}
+
+//Draw one big character (index into BigMap).
+static void BigDraw(uint8_t Ch, uint8_t X, uint8_t Y){
+	uint8_t Row, Col;
+
+	for(Row = 0; Row<2; Row++){
+		H_GoTo(X, Y+Row);
+
+		for(Col = 0; Col<3; Col++){
+			H_PutC(BigChars[BigMap[Ch][Row*3+Col]]);
+		}
+	}
+}
+
+//Set up a big number field W big characters wide with
+//its top left character at X, Y. The field is cleared
+//on the first BigNum. Returns -1 if it doesn't fit
+//across the screen, -2 if it doesn't fit down.
+int8_t BigInit(H_BigNum* B, uint8_t X, uint8_t Y, uint8_t W){
+	uint8_t Cnt;
+
+	if(W>H_BigMax || X+W*H_BigPitch-(H_BigPitch-3)>H_XSize) return -1;
+	if(!H_RowOK(Y) || !H_RowOK(Y+1)) return -2;
+
+	B->X = X;
+	B->Y = Y;
+	B->W = W;
+
+	//Nothing drawn yet, so everything differs.
+	for(Cnt = 0; Cnt<W; Cnt++){
+		B->Last[Cnt] = 0xFF;
+	}
+
+	return 0;
+}
+
+//Print a number in big digits, the same way as PNum:
+//a '-' for negative numbers, Pad leading zeros, then
+//the digits, left aligned in the field with the rest
+//blanked. Only big characters that differ from last
+//time are drawn. Returns -1 if the number doesn't fit
+//the field, otherwise the X after its last digit.
+int8_t BigNum(H_BigNum* B, int32_t Num, uint8_t Pad){
+	char Str[H_BigMax], Dig[10];
+	uint8_t Len = 0, Cnt, Digits;
+
+	Digits = H_UDigits(H_Mag(Num), Dig);
+	if(!Digits) Dig[Digits++] = '0';
+	if(Num<0) Str[Len++] = 10;
+
+	//Check the lot fits.
+	if(Len+Pad+Digits>B->W) return -1;
+
+	while(Pad--) Str[Len++] = 0;
+
+	//Big characters are indexed by the digit value.
+	for(Cnt = 0; Cnt<Digits; Cnt++){
+		Str[Len++] = Dig[Cnt]-'0';
+	}
+
+	for(Cnt = Len; Cnt<B->W; Cnt++){
+		Str[Cnt] = 11;
+	}
+
+	//Draw the big characters that changed, clearing
+	//the gap column after them when first drawn.
+	for(Cnt = 0; Cnt<B->W; Cnt++){
+		if(Str[Cnt] == B->Last[Cnt]) continue;
+
+		BigDraw(Str[Cnt], B->X+Cnt*H_BigPitch, B->Y);
+
+		if(B->Last[Cnt] == (char)0xFF && Cnt<B->W-1){
+			PChar(' ', B->X+Cnt*H_BigPitch+3, B->Y);
+			PChar(' ', B->X+Cnt*H_BigPitch+3, B->Y+1);
+		}
+
+		B->Last[Cnt] = Str[Cnt];
+	}
+
+	return B->X+Len*H_BigPitch-(H_BigPitch-3);
+}
+
+//Bar graph characters for 0 to 5 columns filled, the
+//partly filled ones are set by BarFontInit.
+static char BarChars[H_BarSteps+1] = {' ', ' ', ' ', ' ', ' ', (char)0xFF};
+
+//Load the glyphs for characters with 1 to 4 columns
+//filled, pinned and uploaded straight away as with
+//BigFontInit. Returns -1 if there aren't 4 free slots.
+int8_t BarFontInit(void){
+	uint8_t Glyph[8], Cnt, Row;
+	int8_t C;
+
+	for(Cnt = 1; Cnt<H_BarSteps; Cnt++){
+		for(Row = 0; Row<8; Row++){
+			Glyph[Row] = (0x1F<<(H_BarSteps-Cnt))&0x1F;
+		}
+
+		C = CGGet(Glyph);
+		if(C<0) return -1;
+
+		CGPin(C, 1);
+		BarChars[Cnt] = C;
+	}
+
+	CGUpload();
+	return 0;
+}
+
+//Set up a bar graph W characters wide starting at X, Y.
+//The whole bar is drawn on the first BarSet. Returns -1
+//if it doesn't fit across the screen, -2 if the row
+//doesn't exist.
+int8_t BarInit(H_Bar* B, uint8_t X, uint8_t Y, uint8_t W){
+	if(!W || X+W>H_XSize) return -1;
+	if(!H_RowOK(Y)) return -2;
+
+	B->X = X;
+	B->Y = Y;
+	B->W = W;
+	B->Val = 0xFFFF;
+
+	return 0;
+}
+
+//Show a value (in steps) on a bar graph. Only the
+//characters from the old end of the bar to the new one
+//are rewritten, so a small change usually costs one
+//address and one or two data writes.
+void BarSet(H_Bar* B, uint16_t Val){
+	uint8_t From, To, Cnt;
+	uint16_t Fill;
+
+	if(Val>B->W*H_BarSteps) Val = B->W*H_BarSteps;
+	if(Val == B->Val) return;
+
+	//The characters holding the old and new ends.
+	if(B->Val == 0xFFFF){
+		From = 0;
+		To = B->W-1;
+	}
+	else{
+		//The larger end is in the cell before it when
+		//it's on a cell boundary.
+		From = (Val<B->Val ? Val : B->Val)/H_BarSteps;
+		To = ((Val>B->Val ? Val : B->Val)-1)/H_BarSteps;
+	}
+
+	//The run is written in one go, the DDRAM address
+	//incrementing after each character.
+	H_GoTo(B->X+From, B->Y);
+	for(Cnt = From; Cnt<=To; Cnt++){
+		Fill = Cnt*H_BarSteps;
+		Fill = Val>Fill ? Val-Fill : 0;
+		if(Fill>H_BarSteps) Fill = H_BarSteps;
+
+		H_PutC(BarChars[Fill]);
+	}
+
+	B->Val = Val;
+}
+
+//Canvas tiles (one glyph per character, left to right
+//then top to bottom), their character codes and a bit
+//per tile changed since the last CvFlush.
+static uint8_t CvTiles[H_CvCols*H_CvRows][8];
+static char CvChars[H_CvCols*H_CvRows];
+static uint32_t CvDirty = 0;
+
+//Set up the canvas with its top left character at X, Y.
+//A slot is claimed for each tile and the tile
+//characters are printed, after that drawing only
+//changes the CGRAM. The pixels in neighbouring
+//characters are spaced apart by the gaps between
+//characters on the display. Returns -1 if it doesn't
+//fit across the screen or there aren't enough free
+//slots, -2 if it doesn't fit down.
+int8_t CvInit(uint8_t X, uint8_t Y){
+	uint8_t Tile, Row;
+	int8_t C;
+
+	if(X+H_CvCols>H_XSize) return -1;
+	if(!H_RowOK(Y) || !H_RowOK(Y+H_CvRows-1)) return -2;
+
+	for(Tile = 0; Tile<H_CvCols*H_CvRows; Tile++){
+		for(Row = 0; Row<8; Row++){
+			CvTiles[Tile][Row] = 0;
+		}
+
+		C = CGClaim(CvTiles[Tile]);
+
+		//Not enough slots, give back the ones taken.
+		if(C<0){
+			while(Tile--) CGRelease(CvChars[Tile]);
+			return -1;
+		}
+
+		CvChars[Tile] = C;
+	}
+
+	CvDirty = 0;
+	CGUpload();
+
+	for(Row = 0; Row<H_CvRows; Row++){
+		H_GoTo(X, Y+Row);
+
+		for(Tile = 0; Tile<H_CvCols; Tile++){
+			H_PutC(CvChars[Row*H_CvCols+Tile]);
+		}
+	}
+
+	return 0;
+}
+
+//Turn every pixel off.
+void CvClear(void){
+	uint8_t Tile, Row;
+
+	for(Tile = 0; Tile<H_CvCols*H_CvRows; Tile++){
+		for(Row = 0; Row<8; Row++){
+			if(CvTiles[Tile][Row]){
+				CvTiles[Tile][Row] = 0;
+				CvDirty |= 1UL<<Tile;
+			}
+		}
+	}
+}
+
+//Set (On = 1) or clear (On = 0) the pixel at X, Y, 0, 0
+//being the top left. Pixels off the canvas are ignored
+//so shapes can be clipped at the edges.
+void CvPixel(uint8_t X, uint8_t Y, uint8_t On){
+	uint8_t Tile, Bit, Old;
+
+	if(X>=H_CvW || Y>=H_CvH) return;
+
+	Tile = (Y>>3)*H_CvCols+X/5;
+	Bit = 0x10>>(X%5);
+	Old = CvTiles[Tile][Y&7];
+
+	if(On) CvTiles[Tile][Y&7] |= Bit;
+	else CvTiles[Tile][Y&7] &= ~Bit;
+
+	if(CvTiles[Tile][Y&7] != Old) CvDirty |= 1UL<<Tile;
+}
+
+//Draw a line from X0, Y0 to X1, Y1 (Bresenham).
+void CvLine(uint8_t X0, uint8_t Y0, uint8_t X1, uint8_t Y1, uint8_t On){
+	int16_t DX = X1>X0 ? X1-X0 : X0-X1;
+	int16_t DY = Y1>Y0 ? Y0-Y1 : Y1-Y0;
+	int8_t SX = X0<X1 ? 1 : -1, SY = Y0<Y1 ? 1 : -1;
+	int16_t Err = DX+DY, E2;
+
+	for(;;){
+		CvPixel(X0, Y0, On);
+		if(X0 == X1 && Y0 == Y1) break;
+
+		E2 = 2*Err;
+		if(E2>=DY){
+			Err += DY;
+			X0 += SX;
+		}
+		if(E2<=DX){
+			Err += DX;
+			Y0 += SY;
+		}
+	}
+}
+
+//Draw a W by H rectangle with its top left pixel at
+//X, Y, filled if Fill is set, otherwise just the
+//outline.
+void CvRect(uint8_t X, uint8_t Y, uint8_t W, uint8_t H, uint8_t Fill, uint8_t On){
+	uint8_t CX, CY;
+
+	if(!W || !H) return;
+
+	//Pixels off the canvas are skipped, which also keeps
+	//the counters from wrapping.
+	for(CY = Y; CY<Y+H && CY<H_CvH; CY++){
+		for(CX = X; CX<X+W && CX<H_CvW; CX++){
+			if(Fill || CY == Y || CY == Y+H-1 || CX == X || CX == X+W-1){
+				CvPixel(CX, CY, On);
+			}
+		}
+	}
+}
+
+//Send the tiles changed since the last flush. Only
+//their slots are uploaded, consecutive ones as one
+//block after a single CGRAM address.
+void CvFlush(void){
+	uint8_t Tile;
+
+	if(!CvDirty) return;
+
+	for(Tile = 0; Tile<H_CvCols*H_CvRows; Tile++){
+		if(CvDirty&(1UL<<Tile)) CGSetGlyph(CvChars[Tile], CvTiles[Tile]);
+	}
+
+	CvDirty = 0;
+	CGUpload();
+}
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef HD44780GFX_H
+#define HD44780GFX_H
+
+#include <HD44780CG.h>
+
+//Custom character graphics built on the glyph cache,
+//available when H_USE_CG is defined in HD44780CG.h.
+
+//Big digits are 3 characters wide and 2 rows tall,
+//with a blank column between them. H_BigMax is the
+//most big characters a field can hold (40 columns).
+#define H_BigPitch	4
+#define H_BigMax	10
+
+//Big number field: top left position (Y being the top
+//of the two rows), width in big characters and the
+//characters currently drawn, so only the ones that
+//change are redrawn.
+typedef struct{
+	uint8_t X;
+	uint8_t Y;
+	uint8_t W;
+	char Last[H_BigMax];
+} H_BigNum;
+
+//Bar graphs have 5 steps per character, one per pixel
+//column.
+#define H_BarSteps	5
+
+//Bar graph state: position of the leftmost character,
+//width in characters and the value shown in steps
+//(0 to W*H_BarSteps).
+typedef struct{
+	uint8_t X;
+	uint8_t Y;
+	uint8_t W;
+	uint16_t Val;
+} H_Bar;
+
+//Canvas size in characters and pixels. It takes one
+//CGRAM slot per character, so all 8 by default.
+#define H_CvCols	4
+#define H_CvRows	2
+#define H_CvW		(H_CvCols*5)
+#define H_CvH		(H_CvRows*8)
+
+#ifdef H_USE_CG
+//Big digit functions
+int8_t BigFontInit(void);
+int8_t BigInit(H_BigNum*, uint8_t, uint8_t, uint8_t);
+int8_t BigNum(H_BigNum*, int32_t, uint8_t);
+
+//Bar graph functions
+int8_t BarFontInit(void);
+int8_t BarInit(H_Bar*, uint8_t, uint8_t, uint8_t);
+void BarSet(H_Bar*, uint16_t);
+
+//Canvas functions
+int8_t CvInit(uint8_t, uint8_t);
+void CvClear(void);
+void CvPixel(uint8_t, uint8_t, uint8_t);
+void CvLine(uint8_t, uint8_t, uint8_t, uint8_t, uint8_t);
+void CvRect(uint8_t, uint8_t, uint8_t, uint8_t, uint8_t, uint8_t);
+void CvFlush(void);
+#endif
+
+#endif
@@ -1,4 +1,5 @@
 #include <HD44780LIB.h>
+#include <HD44780FB.h>
 
 /*
  * HD44780LIB.c
@@ -13,7 +14,8 @@
  *simple external circuit. The library also offers 4bits
  *of backlight brightness control through simple PWM.
  *The library is dependent on a SysTick interrupt and a
- *1ms Delay function provided in the example code.
+ *1ms Delay function provided in the example code. Shorter
+ *waits are timed from the SysTick current value register.
  *The library also offers simple functions to print strings,
  *characters and numbers, along with clearing the display
  *and a few simple math functions meaning that minimal
@@ -83,24 +85,166 @@ void H_ChargePump(void){
 	CPState^=1;
 }
 
+//Display geometries. Two line controllers start the
+//second line at 0x40, four row displays are two long
+//lines split in half.
+const H_Geometry H_Geo8x1  = {8,  1, {0x00}};
+const H_Geometry H_Geo8x2  = {8,  2, {0x00, 0x40}};
+const H_Geometry H_Geo16x2 = {16, 2, {0x00, 0x40}};
+const H_Geometry H_Geo16x4 = {16, 4, {0x00, 0x40, 0x10, 0x50}};
+const H_Geometry H_Geo20x2 = {20, 2, {0x00, 0x40}};
+const H_Geometry H_Geo20x4 = {20, 4, {0x00, 0x40, 0x14, 0x54}};
+const H_Geometry H_Geo40x2 = {40, 2, {0x00, 0x40}};
+
+//Geometry of the display in use.
+const H_Geometry* H_Geo = &H_Geo16x2;
+
+//Set the display geometry, call this before H_HWInit
+//so the right number of lines is configured.
+void H_SetGeometry(const H_Geometry* Geo){
+	H_Geo = Geo;
+}
+
+//Number of columns the display has been shifted left
+//by H_Scroll (0 to H_LineLen-1). Clear display and
+//return home set it back to 0.
+uint8_t H_ShiftOff = 0;
+
+//Shift of each display by enable pin number, H_ShiftOff
+//being saved and restored from here by H_SelDisp.
+static uint8_t H_ShiftOffs[16];
+
+//Find the DDRAM address of the character shown at
+//X, Y, taking the display shift into account. X can
+//be beyond the screen, up to H_LineLen-1, to reach
+//the part of the DDRAM line that isn't shown.
+uint8_t H_CellAdd(uint8_t X, uint8_t Y){
+	uint8_t Add = H_Geo->RowAdd[Y-1], Pos;
+
+	if(!H_ShiftOff) return Add+X;
+
+	//Shifting moves the window over each DDRAM line,
+	//wrapping at the end of the line.
+	Pos = (Add&(H_YSize>1?0x3F:0x7F))+X+H_ShiftOff;
+	while(Pos>=H_LineLen) Pos-=H_LineLen;
+
+	return (Add&(H_YSize>1?0x40:0x00))|Pos;
+}
+
+//Scroll the display contents by Cols columns using
+//the display shift instruction, one 37us instruction
+//per column instead of a redraw. Positive values
+//move the contents right, negative values left. Note
+//the HD44780 shifts all lines together! Later prints
+//are placed relative to the screen, not the shifted
+//contents.
+void H_Scroll(int8_t Cols){
+	for(; Cols>0; Cols--){
+		H_Put(H_CurDispShft|H_DispShift|H_ShiftRight, 0);
+	}
+
+	for(; Cols<0; Cols++){
+		H_Put(H_CurDispShft|H_DispShift|H_ShiftLeft, 0);
+	}
+}
+
+//Setup a marquee for a string of any length (e.g. a
+//const string in flash) on row Y. The whole DDRAM
+//line is filled, the part that isn't shown holding
+//the next characters to scroll into view. The string
+//repeats, add some trailing spaces to separate the
+//repeats. As the whole line is used, this only works
+//on one and two line displays, the rows of a four row
+//display share their DDRAM lines (a row 1 marquee
+//would run through row 3). Note the HD44780 shifts
+//every line together! Returns -1 if the string is
+//empty, the row isn't on screen or the display has
+//more than two rows, in which case MarqueeStep does
+//nothing.
+int8_t MarqueeInit(H_Marquee* M, const char* S, uint8_t Y){
+	uint8_t Cnt;
+
+	M->S = S;
+	M->Y = Y;
+	M->Pos = 0;
+	M->Len = 0;
+
+	if(H_YSize>2 || !H_RowOK(Y)) return -1;
+
+	while(S[M->Len]) M->Len++;
+	if(!M->Len) return -1;
+
+	for(Cnt = 0; Cnt<H_LineLen; Cnt++){
+		H_SetAdd(H_CellAdd(Cnt, Y));
+		H_Put(S[Cnt%M->Len], 1);
+	}
+
+	return 0;
+}
+
+//Move a marquee on by one character. The display is
+//shifted left and the DDRAM character that has just
+//scrolled off the screen is loaded with the character
+//coming into view one line length later, so each step
+//costs a shift, an address and a data write however
+//long the string is.
+void MarqueeStep(H_Marquee* M){
+	if(!M->Len || !H_RowOK(M->Y)) return;
+
+	H_Scroll(-1);
+	M->Pos++;
+	if(M->Pos>=M->Len) M->Pos = 0;
+
+	//After the shift, the character just scrolled off
+	//the left of the screen is the one furthest ahead.
+	H_SetAdd(H_CellAdd(H_LineLen-1, M->Y));
+	H_Put(M->S[(M->Pos+H_LineLen-1)%M->Len], 1);
+}
+
 //GPIO type definition for HW initialization.
 GPIO_InitTypeDef G;
 
+//Busy flag polling is only valid once the display
+//has been put into 4bit mode, until then the fixed
+//delays are used.
+static uint8_t H_BFReady = 0;
+
+//Enable pin(s) of the currently selected display(s).
+volatile uint16_t H_ENSel = H_EN;
+
+static void H_InitWrite(uint8_t);
+#ifdef H_USE_QUEUE
+static void H_QInit(void);
+#endif
+
 //Hardware initialization function, change parameters
 //here if different pins are used!
 void H_HWInit(void){
-	//Send the clock to the GPIOA peripheral for the
-	//HD44780 pins, change this dependent on which
-	//GPIO you use.
-	RCC_AHBPeriphClockCmd(RCC_AHBPeriph_GPIOA, ENABLE);
+	uint8_t Pin;
+
+#ifdef H_USE_QUEUE
+	//Empty the queue and setup its timer.
+	H_QInit();
+#endif
+
+	//Send the clock to the GPIO peripheral for the
+	//HD44780 pins, set by H_GPIORCC in the header.
+	RCC_AHBPeriphClockCmd(H_GPIORCC, ENABLE);
 
 	//Initialize all HD44780 pins as outputs.
 	//The interface is pretty slow so lets cut
 	//out the potential for all that EMI by setting
 	//the output speed to the slowest (2MHz - also
 	//defined in the datasheet as the fastest rate
-	//for the HD44780 data port).
-	G.GPIO_Pin = H_RS|H_EN|H_D1|H_D2|H_D3|H_D4|H_LEDCtrl|H_ChgPmp;
+	//for the HD44780 data port). The 4bit data pins
+	//are left alone on the 8bit bus.
+	G.GPIO_Pin = H_RS|H_ENAll|H_LEDCtrl|H_ChgPmp;
+#ifndef H_BUS8B
+	G.GPIO_Pin |= H_D1|H_D2|H_D3|H_D4;
+#endif
+#ifdef H_USE_RW
+	G.GPIO_Pin |= H_RW;
+#endif
 	G.GPIO_Mode = GPIO_Mode_OUT;
 	G.GPIO_OType = GPIO_OType_PP;
 	G.GPIO_PuPd = GPIO_PuPd_NOPULL;
@@ -108,34 +252,188 @@ void H_HWInit(void){
 	GPIO_Init(HD44780_GPIO, &G);
 
 	//Initialize the outputs.
-	GPIO_ResetBits(HD44780_GPIO, H_RS|H_D1|H_D2|H_D3|H_D4);
-	GPIO_SetBits(HD44780_GPIO, H_EN);
+#ifdef H_BUS8B
+	GPIO_ResetBits(HD44780_GPIO, H_RS|H_ENAll);
+#else
+	GPIO_ResetBits(HD44780_GPIO, H_RS|H_ENAll|H_D1|H_D2|H_D3|H_D4);
+#endif
+
+#ifdef H_BUS8B
+	//In 8bit mode, the data pins live on their own
+	//port. The same slow output speed is used.
+	RCC_AHBPeriphClockCmd(H_DataRCC, ENABLE);
+	G.GPIO_Pin = H_DataPins;
+	GPIO_Init(H_DataGPIO, &G);
+	GPIO_ResetBits(H_DataGPIO, H_DataPins);
+#endif
+#ifdef H_USE_RW
+	GPIO_ResetBits(HD44780_GPIO, H_RW);
+#endif
+
+	//Fixed delays until the interface is setup.
+	H_BFReady = 0;
+	H_AC = H_ACUnknown;
+
+	//Initialize all displays on the bus at once, the
+	//clear leaving none of them shifted.
+	H_ENSel = H_ENAll;
+	for(Pin = 0; Pin<16; Pin++){
+		H_ShiftOffs[Pin] = 0;
+	}
 
 	//Delay required for power supply stability.
 	Delay(50);
 
-	//Initialize the screen in 4bit data interface mode
-	H_W8b(H_SetFunction|H_DataLength4b, 0);
-	Delay(5);
-
-	//Set the amount of display lines to 2 and the
-	//character font size to 5x8 (5 pixels by 8 pixels
-	//per character).
-	H_W8b(H_SetFunction|H_DataLength4b|H_DispLines2|H_CharFont5x8, 0);
-	Delay(1);
+	//Reset the interface whatever state the HD44780 is
+	//in (it may still be in 4bit mode, even half way
+	//through a byte, if only the microcontroller was
+	//reset). This is the datasheet's initialization by
+	//instruction: three 8bit function sets, each a
+	//single write, with the waits it requires.
+	H_InitWrite(H_SetFunction|H_DataLength8b);
+	H_DelayUs(4100);
+	H_InitWrite(H_SetFunction|H_DataLength8b);
+	H_DelayUs(100);
+	H_InitWrite(H_SetFunction|H_DataLength8b);
+	H_DelayUs(100);
+
+#ifndef H_BUS8B
+	//Switch to the 4bit interface, still a single
+	//write as the HD44780 is in 8bit mode.
+	H_InitWrite(H_SetFunction|H_DataLength4b);
+	H_DelayUs(100);
+#endif
+
+	//Set the amount of display lines (2 unless the
+	//geometry only has one row) and the character font
+	//size to 5x8 (5 pixels by 8 pixels per character).
+	H_W8b(H_SetFunction|H_BusLength|(H_YSize>1?H_DispLines2:H_DispLines1)|H_CharFont5x8, 0);
 
 	//Set the DDRam address to automatically increment.
 	//Disable the display shift.
 	H_W8b(H_EntryModeSet|H_Increment|H_DispShiftDis, 0);
-	Delay(1);
 
-	//Clear the display before turning it on.
-	ClrDisp();
+	//Clear the display before turning it on. This goes
+	//straight to the display whatever the print target
+	//and without the output queue, so it's done before
+	//the next instruction.
+	H_W8b(H_ClearDisp, 0);
+
+	//From here on, the busy flag can be trusted.
+	H_BFReady = 1;
 
 	//Enable the screen!
 	H_W8b(H_DispCtrl|H_DispOn|H_CursorOff|H_CursrPosNBlnk, 0);
+
+	//Talk to the first display from now on.
+	H_ENSel = H_EN;
+}
+
+//Select which display(s) the following writes go to
+//by their enable pins. Several enable pins can be
+//given at once to broadcast identical content (such
+//as CGRAM uploads) to multiple displays. Reads and
+//busy flag polling only happen with a single display
+//selected. Any queued output is sent to the previous
+//selection first. Each display keeps its own display
+//shift, displays selected together should have the
+//same one.
+void H_SelDisp(uint16_t ENPins){
+	uint8_t Pin;
+
+#ifdef H_USE_QUEUE
+	H_QFlush();
+#endif
+	for(Pin = 0; Pin<16; Pin++){
+		if(H_ENSel&(1<<Pin)) H_ShiftOffs[Pin] = H_ShiftOff;
+	}
+
+	H_ENSel = ENPins&H_ENAll;
+
+	for(Pin = 0; Pin<16; Pin++){
+		if(H_ENSel&(1<<Pin)){
+			H_ShiftOff = H_ShiftOffs[Pin];
+			break;
+		}
+	}
+
+	//Each display has its own address counter.
+	H_AC = H_ACUnknown;
+}
+
+#ifdef H_USE_RW
+//Switch the data pins between outputs (for writing)
+//and inputs (for reading back from the HD44780).
+static void H_DataDir(GPIOMode_TypeDef Mode){
+	G.GPIO_Mode = Mode;
+#ifdef H_BUS8B
+	G.GPIO_Pin = H_DataPins;
+	GPIO_Init(H_DataGPIO, &G);
+#else
+	G.GPIO_Pin = H_D1|H_D2|H_D3|H_D4;
+	GPIO_Init(HD44780_GPIO, &G);
+#endif
+}
+#endif
+
+#ifdef H_NibUseLUT
+//BSRR word for putting a nibble onto the data pins.
+//The lower half of BSRR sets pins and the upper half
+//resets them, so each word drives all four data
+//lines (ones and zeros) with a single 32bit store.
+#define H_NibBit(N, B, Pin) (((N)&(B))?(uint32_t)(Pin):((uint32_t)(Pin)<<16))
+#define H_NibWord(N) (H_NibBit(N, 8, H_D4)|H_NibBit(N, 4, H_D3)|\
+					  H_NibBit(N, 2, H_D2)|H_NibBit(N, 1, H_D1))
+
+//Precomputed nibble to BSRR word table, generated at
+//compile time from the H_D1..H_D4 pin masks so it
+//lives in flash. Only needed when the data pins
+//aren't consecutive.
+const uint32_t H_NibLUT[16] = {
+	H_NibWord(0),  H_NibWord(1),  H_NibWord(2),  H_NibWord(3),
+	H_NibWord(4),  H_NibWord(5),  H_NibWord(6),  H_NibWord(7),
+	H_NibWord(8),  H_NibWord(9),  H_NibWord(10), H_NibWord(11),
+	H_NibWord(12), H_NibWord(13), H_NibWord(14), H_NibWord(15)
+};
+#endif
+
+//Short delay to satisfy the enable pulse width and
+//enable cycle time (450ns/1000ns at 3V). Consecutive
+//stores to BSRR are only a couple of cycles apart!
+static void H_ENDelay(void){
+	volatile uint8_t Cnt;
+	for(Cnt = 0; Cnt<H_ENHold; Cnt++);
+}
+
+//Strobe the enable pin(s) of the selected display(s).
+//Data is latched by the HD44780 on the falling edge of
+//the enable pin.
+static void H_Strobe(void){
+	HD44780_GPIO->BSRR = H_ENSel;
+	H_ENDelay();
+	HD44780_GPIO->BRR = H_ENSel;
+	H_ENDelay();
 }
 
+#ifdef H_BUS8B
+//Put a whole byte onto the 8bit bus. Set bits take
+//priority over reset bits in BSRR so resetting all
+//eight pins whilst setting the ones in Data drives
+//the bus with a single store.
+static void H_WByte(uint8_t Data, uint32_t RSWord){
+	HD44780_GPIO->BSRR = RSWord;
+	H_DataGPIO->BSRR = ((uint32_t)H_DataPins<<16)|((uint32_t)Data<<H_DB0Pin);
+	H_Strobe();
+}
+#else
+//Put a nibble and the RS level onto the bus with a
+//single store, then strobe the enable pin.
+static void H_WNib(uint8_t Nib, uint32_t RSWord){
+	HD44780_GPIO->BSRR = H_NibBSRR(Nib)|RSWord;
+	H_Strobe();
+}
+#endif
+
 //Our standard 8 bit value write. The HD44780
 //works in both 8bit and 4bit data modes. 4bit
 //mode obviously requiring fewer pins from the
@@ -148,28 +446,474 @@ void H_HWInit(void){
 //value will be written to the DDRAM (for characters).
 //If RD is equal to 0, the data will be written to the
 //instruction registers.
+//
+//Each nibble is a shift (or table lookup for non
+//consecutive data pins) and three stores, where the
+//old GPIO_WriteBit/SetBits version took 7 library
+//calls per nibble. The BENCHMARK in main.c times
+//putting nibbles onto the pins both ways and shows
+//the cycles per nibble of each.
 void H_W8b(uint8_t Data, uint8_t RD){
-	GPIO_ResetBits(HD44780_GPIO, H_D1|H_D2|H_D3|H_D4);
+	H_Track(Data, RD);
+	H_Bus8b(Data, RD);
+	H_WaitReady(H_ExecUs(Data, RD));
+}
+
+//Put 8 bits onto the bus without waiting for the
+//HD44780 to execute them, used by H_W8b and by the
+//output queue which paces the writes itself.
+void H_Bus8b(uint8_t Data, uint8_t RD){
+	uint32_t RSWord = RD?(uint32_t)H_RS:((uint32_t)H_RS<<16);
+
+#ifdef H_BUS8B
+	H_WByte(Data, RSWord);
+#else
+	H_WNib(Data>>4, RSWord);
+	H_WNib(Data, RSWord);
+#endif
+}
+
+//Write an instruction with a single enable pulse
+//whilst the HD44780 may still be in 8bit mode. On the
+//4bit bus only the upper nibble gets sent, which is
+//all the 8bit function set needs.
+static void H_InitWrite(uint8_t Data){
+#ifdef H_BUS8B
+	H_WByte(Data, (uint32_t)H_RS<<16);
+#else
+	H_WNib(Data>>4, (uint32_t)H_RS<<16);
+#endif
+}
+
+//Address counter tracking. The library follows the
+//HD44780 address counter and entry mode through every
+//byte written, so DDRAM address instructions can be
+//skipped when the next write already lands on the
+//right character.
+uint8_t H_AC = H_ACUnknown;
+static uint8_t H_ACInc = 1, H_ACCG = 0, H_ACShift = 0;
+
+//Move the tracked address counter on after a data
+//write, following the wrap of the DDRAM lines (0x27
+//to 0x40 and 0x67 to 0x00 for two line displays, 0x4F
+//to 0x00 for single line displays).
+static void H_ACStep(void){
+	if(H_ACCG){
+		H_AC = (H_AC+(H_ACInc?1:-1))&0x3F;
+	}
+	else if(H_YSize>1){
+		if(H_ACInc){
+			if(H_AC == 0x27) H_AC = 0x40;
+			else if(H_AC == 0x67) H_AC = 0x00;
+			else H_AC++;
+		}
+		else{
+			if(H_AC == 0x40) H_AC = 0x27;
+			else if(H_AC == 0x00) H_AC = 0x67;
+			else H_AC--;
+		}
+	}
+	else{
+		if(H_ACInc) H_AC = (H_AC == 0x4F)?0x00:H_AC+1;
+		else H_AC = (H_AC == 0x00)?0x4F:H_AC-1;
+	}
+}
+
+//Follow a display shift, left moving the contents
+//left so the first column shows the next DDRAM
+//position.
+static void H_ShiftStep(uint8_t Left){
+	if(Left) H_ShiftOff = (H_ShiftOff+1<H_LineLen)?H_ShiftOff+1:0;
+	else H_ShiftOff = H_ShiftOff?H_ShiftOff-1:H_LineLen-1;
+}
+
+//Update the tracked address counter and entry mode
+//for an instruction (RD = 0) or data write (RD = 1)
+//about to be sent. With the entry mode display shift
+//(H_DispShiftEn) on, each DDRAM write also shifts the
+//display the way the address counter moves.
+void H_Track(uint8_t Data, uint8_t RD){
+	if(RD){
+		if(H_AC != H_ACUnknown) H_ACStep();
+		if(H_ACShift && !H_ACCG) H_ShiftStep(H_ACInc);
+		return;
+	}
+
+	switch(H_ExecClass(Data, RD)){
+	//Clear display also sets the entry mode to
+	//increment.
+	case 0:
+		H_ACInc = 1;
+		H_AC = 0;
+		H_ACCG = 0;
+		H_ShiftOff = 0;
+		break;
+	case 1:
+		H_AC = 0;
+		H_ACCG = 0;
+		H_ShiftOff = 0;
+		break;
+	case 2:
+		H_ACInc = (Data&H_Increment)?1:0;
+		H_ACShift = (Data&H_DispShiftEn)?1:0;
+		break;
+	//Cursor moves change the address counter, display
+	//shifts move the window over DDRAM instead. A right
+	//shift moves the contents right, so the first
+	//column then shows the previous DDRAM position.
+	case 4:
+		if(!(Data&H_DispShift)) H_AC = H_ACUnknown;
+		else H_ShiftStep(!(Data&H_ShiftRight));
+		break;
+	case 6:
+		H_AC = Data&0x3F;
+		H_ACCG = 1;
+		break;
+	case 7:
+		H_AC = Data&0x7F;
+		H_ACCG = 0;
+		break;
+	}
+}
+
+//Point the address counter at a DDRAM address unless
+//it's already there. Returns 1 if an instruction was
+//sent.
+uint8_t H_SetAdd(uint8_t Add){
+	if(H_AC == Add && !H_ACCG) return 0;
+
+	H_Put(H_SetDDRamAdd|Add, 0);
+	return 1;
+}
+
+//Tracked DDRAM address, H_ACUnknown if unknown or if
+//the address counter points into CGRAM.
+uint8_t H_DDAdd(void){
+	return H_ACCG?H_ACUnknown:H_AC;
+}
+
+//Tracked entry mode, the H_EntryModeSet instruction
+//with the H_Increment and H_DispShiftEn bits last set.
+uint8_t H_EntryMode(void){
+	return H_EntryModeSet|(H_ACInc?H_Increment:H_Decrement)|(H_ACShift?H_DispShiftEn:H_DispShiftDis);
+}
+
+//Execution time in us of each instruction class at
+//the nominal 270kHz oscillator. Instructions are
+//identified by their most significant set bit, data
+//writes (RD = 1) take an extra 4us to update the
+//address counter.
+static const uint16_t H_ExecTable[H_ExecClasses] = {
+	1520,	//H_ClearDisp
+	1520,	//H_RetHome
+	37,		//H_EntryModeSet
+	37,		//H_DispCtrl
+	37,		//H_CurDispShft
+	37,		//H_SetFunction
+	37,		//H_SetCGRAMAdd
+	37,		//H_SetDDRamAdd
+	41		//Data write
+};
+
+//Execution time margin in percent, increase this for
+//slow clones or HD44780s running at low voltages
+//where the oscillator is slower.
+volatile uint16_t H_ExecMargin = 110;
+
+//Find the class of an instruction (index into
+//H_ExecTable) from its most significant set bit.
+uint8_t H_ExecClass(uint8_t Data, uint8_t RD){
+	uint8_t Class = 7;
+
+	if(RD) return H_ExecData;
+
+	while(Class && !(Data&(1<<Class))) Class--;
+	return Class;
+}
+
+//Execution time in us of an instruction or data
+//write, including the margin.
+uint16_t H_ExecUs(uint8_t Data, uint8_t RD){
+	return ((uint32_t)H_ExecTable[H_ExecClass(Data, RD)]*H_ExecMargin)/100;
+}
+
+//Read 8 bits back from the HD44780. If RD is equal
+//to 0, the busy flag (bit 7) and address counter
+//(bits 6 to 0) are read. If RD is equal to 1, the
+//data at the current address is read. Only works
+//if the R/W line is connected (H_USE_RW), otherwise
+//0 is returned!
+uint8_t H_R8b(uint8_t RD){
+	uint8_t Data = 0;
+#ifdef H_USE_RW
+	//Multiple displays can't drive the bus at once!
+	if(!H_OneDisp(H_ENSel)) return 0;
+
+	//Release the data lines and put the HD44780
+	//into read mode.
+	H_DataDir(GPIO_Mode_IN);
 	GPIO_WriteBit(HD44780_GPIO, H_RS, RD);
-	GPIO_SetBits(HD44780_GPIO, H_EN);
+	GPIO_SetBits(HD44780_GPIO, H_RW);
+
+#ifdef H_BUS8B
+	//The whole byte is presented whilst the enable
+	//pin is high.
+	GPIO_SetBits(HD44780_GPIO, H_ENSel);
+	H_ENDelay();
+	Data = GPIO_ReadInputData(H_DataGPIO)>>H_DB0Pin;
+	GPIO_ResetBits(HD44780_GPIO, H_ENSel);
+	H_ENDelay();
+#else
+	//The most significant nibble is presented first
+	//whilst the enable pin is high. The data is only
+	//valid a while (tDDR) after the rising edge, and
+	//the enable pin has the same minimum high and low
+	//times as for writes.
+	GPIO_SetBits(HD44780_GPIO, H_ENSel);
+	H_ENDelay();
+	if(GPIO_ReadInputDataBit(HD44780_GPIO, H_D4)) Data |= (1<<7);
+	if(GPIO_ReadInputDataBit(HD44780_GPIO, H_D3)) Data |= (1<<6);
+	if(GPIO_ReadInputDataBit(HD44780_GPIO, H_D2)) Data |= (1<<5);
+	if(GPIO_ReadInputDataBit(HD44780_GPIO, H_D1)) Data |= (1<<4);
+	GPIO_ResetBits(HD44780_GPIO, H_ENSel);
+	H_ENDelay();
+
+	//Followed by the least significant nibble.
+	GPIO_SetBits(HD44780_GPIO, H_ENSel);
+	H_ENDelay();
+	if(GPIO_ReadInputDataBit(HD44780_GPIO, H_D4)) Data |= (1<<3);
+	if(GPIO_ReadInputDataBit(HD44780_GPIO, H_D3)) Data |= (1<<2);
+	if(GPIO_ReadInputDataBit(HD44780_GPIO, H_D2)) Data |= (1<<1);
+	if(GPIO_ReadInputDataBit(HD44780_GPIO, H_D1)) Data |= (1<<0);
+	GPIO_ResetBits(HD44780_GPIO, H_ENSel);
+	H_ENDelay();
+#endif
+
+	//Back to write mode, driving the data lines.
+	GPIO_ResetBits(HD44780_GPIO, H_RW);
+	H_DataDir(GPIO_Mode_OUT);
+
+	//Data reads move the address counter on like
+	//writes do.
+	if(RD && H_AC != H_ACUnknown) H_ACStep();
+#endif
+	return Data;
+}
 
-	GPIO_WriteBit(HD44780_GPIO, H_D4, Data&(1<<7));
-	GPIO_WriteBit(HD44780_GPIO, H_D3, Data&(1<<6));
-	GPIO_WriteBit(HD44780_GPIO, H_D2, Data&(1<<5));
-	GPIO_WriteBit(HD44780_GPIO, H_D1, Data&(1<<4));
+//Wait until the HD44780 is ready for the next
+//transfer. With the R/W line connected, the busy
+//flag is polled which takes ~37us for most
+//instructions. Polling gives up once Us microseconds
+//(the execution time of the last instruction, with
+//H_ExecMargin) have passed on the SysTick, as the
+//instruction must have finished by then whatever the
+//clock or the time each poll takes. Without the R/W
+//line (or with several displays selected), the whole
+//Us is waited for.
+void H_WaitReady(uint16_t Us){
+	uint32_t Ticks = Us*(SystemCoreClock/1000000);
+	uint32_t Last = SysTick->VAL, Elapsed = 0;
+
+#ifdef H_USE_RW
+	if(H_BFReady && H_OneDisp(H_ENSel)){
+		while(Elapsed<Ticks){
+			if(!(H_R8b(0)&(1<<7))) return;
+			Elapsed += H_TicksSince(&Last);
+		}
+	}
+#endif
 
-	GPIO_ResetBits(HD44780_GPIO, H_EN);
+	//Only what's left of the execution time.
+	while(Elapsed<Ticks){
+		Elapsed += H_TicksSince(&Last);
+	}
+}
 
-	GPIO_SetBits(HD44780_GPIO, H_EN);
+//Output function used by all of the print functions.
+//With H_USE_QUEUE defined, bytes are added to the
+//output queue and sent in the background, otherwise
+//they are written straight away.
+void H_Put(uint8_t Data, uint8_t RD){
+#ifdef H_USE_QUEUE
+	H_QPut(Data, RD);
+#else
+	H_W8b(Data, RD);
+#endif
+}
 
-	GPIO_WriteBit(HD44780_GPIO, H_D4, Data&(1<<3));
-	GPIO_WriteBit(HD44780_GPIO, H_D3, Data&(1<<2));
-	GPIO_WriteBit(HD44780_GPIO, H_D2, Data&(1<<1));
-	GPIO_WriteBit(HD44780_GPIO, H_D1, Data&(1<<0));
+//Where the print functions draw to, the display itself
+//(H_TargetLCD) or the framebuffer (H_TargetFB).
+uint8_t H_Target = H_TargetLCD;
 
-	GPIO_ResetBits(HD44780_GPIO, H_EN);
+//Select where the print functions draw to. Drawing
+//to the framebuffer requires H_USE_FB.
+void H_SetTarget(uint8_t Target){
+	H_Target = Target;
+}
 
-	Delay(1);
+//Column of the print position, used to blank fill
+//fixed width fields.
+static uint8_t H_CurX = 0;
+
+//Move the print position to X, Y. The position must
+//already have been checked to be on screen.
+void H_GoTo(uint8_t X, uint8_t Y){
+	H_CurX = X;
+#ifdef H_USE_FB
+	if(H_Target == H_TargetFB){
+		FBGoTo(X, Y);
+		return;
+	}
+#endif
+	H_SetAdd(H_CellAdd(X, Y));
+}
+
+//Print a character at the print position, which then
+//moves on by one.
+void H_PutC(char C){
+	H_CurX++;
+#ifdef H_USE_FB
+	if(H_Target == H_TargetFB){
+		FBPutC(C);
+		return;
+	}
+#endif
+	H_Put(C, 1);
+}
+
+#ifdef H_USE_QUEUE
+//Output queue, a ring buffer of instruction/data
+//bytes with bit 8 holding RS. The queue is written
+//by the main loop (H_QPut) and read by the queue timer
+//interrupt (H_QIRQHandler), each side only ever moves
+//its own index so no locking is required.
+static volatile uint16_t H_Queue[H_QSize];
+static volatile uint8_t H_QHead = 0, H_QTail = 0;
+
+//Largest number of entries the queue has held,
+//useful for tuning H_QSize.
+volatile uint8_t H_QHighWater = 0;
+
+//Setup the queue timer, called by H_HWInit. The timer
+//counts in us and interrupts on each update, it only
+//runs whilst there's something to send.
+static void H_QInit(void){
+	RCC_APB1PeriphClockCmd(H_QTIMRCC, ENABLE);
+
+	H_QTIM->CR1 = 0;
+	H_QTIM->PSC = (SystemCoreClock/1000000)-1;
+
+	//Load the prescaler, then clear the update flag
+	//this sets.
+	H_QTIM->EGR = TIM_EGR_UG;
+	H_QTIM->SR = 0;
+	H_QTIM->DIER = TIM_DIER_UIE;
+
+	H_QHead = 0;
+	H_QTail = 0;
+
+	NVIC_EnableIRQ(H_QIRQn);
+}
+
+//(Re)start the queue timer to interrupt in Us, at
+//least 2us. The counter doesn't count with ARR at 0,
+//so the update would never come.
+static void H_QStart(uint16_t Us){
+	H_QTIM->CNT = 0;
+	H_QTIM->ARR = (Us>2)?Us-1:1;
+	H_QTIM->CR1 |= TIM_CR1_CEN;
+}
+
+//Number of entries currently in the queue.
+uint8_t H_QUsed(void){
+	return (uint8_t)(H_QHead-H_QTail)&(H_QSize-1);
+}
+
+//Add an instruction (RD = 0) or data byte (RD = 1)
+//to the queue. If the queue is full, wait for the
+//interrupt to make some room. A stopped timer means
+//the display has finished with everything sent, so
+//it's started to send the new entry straight away.
+void H_QPut(uint8_t Data, uint8_t RD){
+	uint8_t Next = (H_QHead+1)&(H_QSize-1), Used;
+
+	while(Next == H_QTail) H_Idle();
+
+	H_Track(Data, RD);
+	H_Queue[H_QHead] = Data|(RD?0x100:0);
+	H_QHead = Next;
+
+	if(!(H_QTIM->CR1&TIM_CR1_CEN)) H_QStart(2);
+
+	Used = H_QUsed();
+	if(Used>H_QHighWater) H_QHighWater = Used;
+}
+
+//Queue timer interrupt. The last entry sent has
+//finished executing, so the next one is sent and the
+//timer set to the time it takes to execute: ~45us for
+//characters and most instructions, ~1.67ms for a clear
+//or return home. The display is written as fast as it
+//can take the bytes, and the CPU is only busy for the
+//few us each write takes. With the queue empty, the
+//timer is stopped.
+void H_QIRQHandler(void){
+	uint16_t Entry;
+
+	//Cleared first, an update flag still set on return
+	//would run the handler again and send the next
+	//entry whilst this one is executing.
+	if(!(H_QTIM->SR&TIM_SR_UIF)) return;
+	H_QTIM->SR = ~TIM_SR_UIF;
+
+	if(H_QTail != H_QHead){
+		Entry = H_Queue[H_QTail];
+		H_Bus8b(Entry, Entry>>8);
+		H_QStart(H_ExecUs(Entry, Entry>>8));
+
+		//Taken off the queue once the timer is running
+		//again, so H_QFlush never sees an empty queue
+		//and a stopped timer whilst it's executing.
+		H_QTail = (H_QTail+1)&(H_QSize-1);
+	}
+	else H_QTIM->CR1 &= ~TIM_CR1_CEN;
+}
+
+//Wait until the queue has been fully sent and the
+//last instruction has finished executing, which is
+//when the interrupt stops the timer.
+void H_QFlush(void){
+	while(H_QTail!=H_QHead || (H_QTIM->CR1&TIM_CR1_CEN)) H_Idle();
+}
+#endif
+
+//SysTick ticks (core clock cycles) passed since the
+//current value register read Last, Last being updated.
+//SysTick counts down, if the current value is larger
+//than the last, the counter has wrapped. Its reload
+//value doesn't matter as wraps are accounted for.
+uint32_t H_TicksSince(uint32_t* Last){
+	uint32_t Now = SysTick->VAL, Ticks;
+
+	if(Now<=*Last) Ticks = *Last-Now;
+	else Ticks = *Last+SysTick->LOAD+1-Now;
+
+	*Last = Now;
+	return Ticks;
+}
+
+//Microsecond delay, timed by watching the SysTick
+//current value register count down. The SysTick
+//must already be running (see main.c). Calibrated
+//from SystemCoreClock so it follows any clock
+//changes.
+void H_DelayUs(uint32_t Us){
+	uint32_t Ticks = Us*(SystemCoreClock/1000000);
+	uint32_t Last = SysTick->VAL, Elapsed = 0;
+
+	while(Elapsed<Ticks){
+		Elapsed += H_TicksSince(&Last);
+	}
 }
 
 //Really simple function to find the length of
@@ -237,21 +981,19 @@ int8_t PStr(const char* S, uint8_t X, uint8_t Y){
 	//the screen, return -1
 	if(X>(H_XSize-StrLen)) return -1;
 
-	//If the row is anything other than 1 or 2,
-	//return -2
-	if(Y!=1 && Y!=2) return -2;
+	//If the row doesn't exist, return -2
+	if(!H_RowOK(Y)) return -2;
 
 	//If all the above checks are ok, set the DDRam
 	//address dependent on X position and row
-	if(Y == 1) H_W8b(H_SetDDRamAdd|X, 0);
-	else H_W8b(H_SetDDRamAdd|(0x40+X), 0);
+	H_GoTo(X, Y);
 
 	//Print the string to DDRam character by
 	//character! The DDRam address automatically
 	//increments, as defined by the initial register
 	//values.
 	for(Cnt = 0; Cnt<StrLen; Cnt++){
-		H_W8b(S[Cnt], 1);
+		H_PutC(S[Cnt]);
 	}
 
 	//If all is successful, return current X position!
@@ -260,59 +1002,66 @@ int8_t PStr(const char* S, uint8_t X, uint8_t Y){
 
 //Print a single character at the position X, Y
 //where X is the X position of the row (0 being
-//the first position and 15 being the last) with
-//Y being the row, either row 1 or row 2.
+//the first position and H_XSize-1 being the last)
+//with Y being the row, 1 being the first row.
 int8_t PChar(char C, uint8_t X, uint8_t Y){
 
 	//If the position of the character will be
 	//off the screen, return respective error.
 	if(X>(H_XSize-1)) return -1;
-	if(Y!=1 && Y!=2) return -2;
+	if(!H_RowOK(Y)) return -2;
 
-	//If the row is row 1, the address range
-	//is 0 to 15. If the row is row 2, the
-	//address range is 64 to 79 with 64 being
-	//the co-ordinates (0, 1) and 79 being
-	//(15, 1).
-	if(Y == 1) H_W8b(H_SetDDRamAdd|X, 0);
-	else H_W8b(H_SetDDRamAdd|(0x40+X), 0);
+	//Each row starts at its own DDRAM address,
+	//e.g. on a 16x2 display row 1 is 0 to 15 and
+	//row 2 is 64 to 79, looked up from the geometry.
+	H_GoTo(X, Y);
 
 	//Write the current character to the DDRam
 	//as opposed to an instruction register
-	H_W8b(C, 1);
+	H_PutC(C);
 
 	//If all is successful, current X position will be returned!
 	return X+1;
 }
 
-//A simple function that compares a number to
-//successive powers of 10 to find the base 10
-//length of the number!
-uint8_t CheckNumLength(int32_t Num){
+//Split a number's magnitude (see H_Mag) into its
+//decimal digits, '0' to '9' most significant first.
+//Buf needs room for 10 digits, or can be 0 to only
+//count them. Returns the number of digits, 0 having
+//none (PNum prints nothing for it, which PNumF relies
+//on for its decimals). Shared by every number printing
+//function so they all agree on the length.
+uint8_t H_UDigits(uint32_t Mag, char* Buf){
+	char Rev[10];
 	uint8_t Len = 0, Cnt;
 
-	//Find length of number by continuously
-	//comparing to ascending powers of 10.
-	//When the number is less than the power of
-	//10, the length of the number is found and
-	//the loop is complete. 32bits supports
-	//numbers up to 10dp so that is my max loop
-	//size! If a 64bit system is used, this can be
-	//increased though the FPow function will need
-	//to be changed.
-	for(Cnt = 0; Cnt<10; Cnt++){
-		if(Num>=FPow(10, Cnt)){
-			Len = Cnt;
-		}
-		else{
-			Len = Cnt;
-			break;
+	//Digits are found least significant first.
+	while(Mag){
+		Rev[Len++] = '0'+Mag%10;
+		Mag/=10;
+	}
+
+	if(Buf){
+		for(Cnt = 0; Cnt<Len; Cnt++){
+			Buf[Cnt] = Rev[Len-1-Cnt];
 		}
 	}
 
 	return Len;
 }
 
+//Find the base 10 length of a positive number, 0
+//for 0 or negative numbers.
+uint8_t CheckNumLength(int32_t Num){
+	return (Num>0)?H_UDigits(Num, 0):0;
+}
+
+//Number of characters PNum prints for a number: the
+//sign, the padding and the digits.
+static uint8_t PNumLen(int32_t Num, uint8_t Pad){
+	return (Num<0)+Pad+H_UDigits(H_Mag(Num), 0);
+}
+
 //A cool function to print numbers to the screen.
 //I'm pretty proud of this one, as simple as it is!
 //The number is split into its individual digits
@@ -322,37 +1071,28 @@ uint8_t CheckNumLength(int32_t Num){
 //number padding or the negative sign (if numbers are
 //negative).
 int8_t PNum(int32_t Num, uint8_t X, uint8_t Y, uint8_t Pad){
-	int8_t Cnt = 0, Len = 0, NegNum = 0;
+	char Digits[10];
+	uint8_t Cnt, Len, NegNum = (Num<0);
+	uint8_t Width = PNumLen(Num, Pad);
 
-	//Check to see if number is negative, if so
-	//Abs the number and set the negative number
-	//flag. If positive, NegNum will already be
-	//0 as declared above.
-	if(Num<0){
-		Num = -Num;
-		NegNum = 1;
-	}
-
-	Len = CheckNumLength(Num);
-
-	//If the length of the number will print
+	//If the sign, padding and digits will print
 	//off the screen, return respective error.
-	if(X>((H_XSize-1)-Len)) return -1;
-	if(Y!=1 && Y!=2) return -2;
+	if(X>H_XSize || Width>H_XSize-X) return -1;
+	if(!H_RowOK(Y)) return -2;
 
-	//If the row is row 1, the address range
-	//is 0 to 15. If the row is row 2, the
-	//address range is 64 to 79 with 64 being
-	//the co-ordinates (0, 1) and 79 being
-	//(15, 1).
-	if(Y == 1) H_W8b(H_SetDDRamAdd|X, 0);
-	else H_W8b(H_SetDDRamAdd|(0x40+X), 0);
+	//Split the magnitude into its digits, the sign
+	//being printed separately.
+	Len = H_UDigits(H_Mag(Num), Digits);
+
+	//Set the DDRAM address of the first character
+	//from the geometry row table.
+	H_GoTo(X, Y);
 
 	//If the negative number flag is not equal to
 	//zero then print the - sign before the padding
 	//and numbers
 	if(NegNum){
-		H_W8b('-', 1);
+		H_PutC('-');
 	}
 
 	//Print number padding before the actual number
@@ -360,24 +1100,16 @@ int8_t PNum(int32_t Num, uint8_t X, uint8_t Y, uint8_t Pad){
 	//as it looks much more professional having the
 	//0 as a place holder.
 	for(Cnt = 0; Cnt<Pad; Cnt++){
-		H_W8b('0', 1);
+		H_PutC('0');
 	}
 
 	//Print the actual digits to the number!
-	for(Cnt = Len-1; Cnt>=0; Cnt--){
-		//Write the current number character to
-		//the DDRam as opposed to an instruction
-		//register. The magic happens in how the
-		//number character is calculated utilizing
-		//the truncating integer division and a mod
-		//function. The division could be changed
-		//for a while loop subtracting 10^Cnt until
-		//the number is < that value.
-		H_W8b('0'+ ((Num/FPow(10, Cnt))%10), 1);
+	for(Cnt = 0; Cnt<Len; Cnt++){
+		H_PutC(Digits[Cnt]);
 	}
 
 	//As per, return current X if all is good!
-	return X+Len;
+	return X+Width;
 }
 
 //A somewhat simple fucntion to print floating point
@@ -392,7 +1124,7 @@ int8_t PNumF(float Num, uint8_t X, uint8_t Y, uint8_t Prec){
 	uint8_t Len = 0, Cnt, OriginX, NegNum = 0;
 
 	//If the specified row doesn't exist, return value!
-	if(Y!=1 && Y!=2) return -2;
+	if(!H_RowOK(Y)) return -2;
 
 	//If number is less than zero, print '-' sign
 	//and invert the number.
@@ -501,8 +1233,89 @@ int8_t PNumF(float Num, uint8_t X, uint8_t Y, uint8_t Prec){
 //A simple function to clear the whole display.
 //You could essentially print a string of spaces
 //but this function does it for you - and much
-//faster!
+//faster! When drawing into the framebuffer, the
+//framebuffer is filled with spaces instead.
 void ClrDisp(void){
-	H_W8b(H_ClearDisp, 0);
-	Delay(1);
+#ifdef H_USE_FB
+	if(H_Target == H_TargetFB){
+		FBClear();
+		return;
+	}
+#endif
+	H_Put(H_ClearDisp, 0);
+}
+
+//Find the end of a W character wide field starting at
+//X, cut short at the edge of the screen.
+static uint8_t FieldEnd(uint8_t X, uint8_t W){
+	return (W>H_XSize-X)?H_XSize:X+W;
+}
+
+//Blank fill a field from the print position up to End,
+//after printing into it. Ret is the return value of the
+//print function, if it failed to print (e.g. the number
+//didn't fit) the whole field starting at X is blanked.
+//Returns End or the error from the print function.
+static int8_t FillField(int8_t Ret, uint8_t X, uint8_t Y, uint8_t End){
+	if(Ret<0) H_GoTo(X, Y);
+
+	while(H_CurX<End){
+		H_PutC(' ');
+	}
+
+	return (Ret<0)?Ret:End;
+}
+
+//Fixed width versions of PStr, PNum and PNumF. The
+//field of W characters starting at X is blank filled
+//after the text or number, so a changing value can be
+//overwritten in place without clearing the display
+//first. No flicker and no 1.52ms clear! Nothing is
+//ever printed past the field: strings are cut short
+//and numbers that don't fit blank the field and return
+//-1.
+int8_t PStrW(const char* S, uint8_t X, uint8_t Y, uint8_t W){
+	uint8_t End;
+
+	if(X>(H_XSize-1)) return -1;
+	if(!H_RowOK(Y)) return -2;
+
+	End = FieldEnd(X, W);
+	H_GoTo(X, Y);
+
+	for(; *S && H_CurX<End; S++){
+		H_PutC(*S);
+	}
+
+	return FillField(0, X, Y, End);
+}
+
+int8_t PNumW(int32_t Num, uint8_t X, uint8_t Y, uint8_t Pad, uint8_t W){
+	uint8_t End;
+
+	if(X>(H_XSize-1)) return -1;
+	if(!H_RowOK(Y)) return -2;
+
+	End = FieldEnd(X, W);
+	if(PNumLen(Num, Pad)>End-X) return FillField(-1, X, Y, End);
+
+	return FillField(PNum(Num, X, Y, Pad), X, Y, End);
+}
+
+int8_t PNumFW(float Num, uint8_t X, uint8_t Y, uint8_t Prec, uint8_t W){
+	int32_t INum;
+	uint8_t End, Len;
+
+	if(X>(H_XSize-1)) return -1;
+	if(!H_RowOK(Y)) return -2;
+
+	//Sign, integer part (at least the leading 0),
+	//decimal point and decimals as PNumF prints them.
+	INum = (Num<0.0f)?-Num:Num;
+	Len = (Num<0.0f)+(INum?CheckNumLength(INum):1)+(Prec?Prec+1:0);
+
+	End = FieldEnd(X, W);
+	if(Len>End-X) return FillField(-1, X, Y, End);
+
+	return FillField(PNumF(Num, X, Y, Prec), X, Y, End);
 }
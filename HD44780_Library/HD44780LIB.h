@@ -4,26 +4,158 @@
 #include <stm32f0xx_gpio.h>
 #include <stm32f0xx_rcc.h>
 
-//HD44780 GPIO pin defines, the HD44780
+//HD44780 GPIO port and its clock. All of the pin
+//defines below can be overridden from the compiler
+//command line (e.g. -DH_D1Pin=8) instead of editing
+//this file. Overriding HD44780_GPIO also requires
+//H_GPIORCC and overriding H_D1Pin requires all four
+//data pins.
+#ifndef HD44780_GPIO
+#define HD44780_GPIO GPIOA
+#define H_GPIORCC RCC_AHBPeriph_GPIOA
+#endif
+
+//HD44780 GPIO pin numbers, the HD44780
 //requires no special function pins!
-#define H_RS GPIO_Pin_0
-#define H_EN GPIO_Pin_1
-#define H_D1 GPIO_Pin_2
-#define H_D2 GPIO_Pin_3
-#define H_D3 GPIO_Pin_4
-#define H_D4 GPIO_Pin_5
+#ifndef H_RSPin
+#define H_RSPin 0
+#endif
+#ifndef H_ENPin
+#define H_ENPin 1
+#endif
+#ifndef H_D1Pin
+#define H_D1Pin 2
+#define H_D2Pin 3
+#define H_D3Pin 4
+#define H_D4Pin 5
+#endif
 
 //Pin for controlling the LED backlight!
-#define H_LEDCtrl GPIO_Pin_6
+#ifndef H_LEDCtrlPin
+#define H_LEDCtrlPin 6
+#endif
 
 //Pin required for capacitive charge
 //pump!
-#define H_ChgPmp GPIO_Pin_7
+#ifndef H_ChgPmpPin
+#define H_ChgPmpPin 7
+#endif
 
-#define HD44780_GPIO GPIOA
+//Enable pins of all displays on the bus. Several
+//displays can share RS and the data pins, each having
+//its own enable pin. Add the extra enable pins here,
+//e.g. (H_EN|GPIO_Pin_9|GPIO_Pin_10), then use
+//H_SelDisp to pick the display(s) to write to.
+#ifndef H_ENAll
+#define H_ENAll H_EN
+#endif
+
+//Pin masks, as used with the GPIO library.
+#define H_RS ((uint16_t)(1<<H_RSPin))
+#define H_EN ((uint16_t)(1<<H_ENPin))
+#define H_D1 ((uint16_t)(1<<H_D1Pin))
+#define H_D2 ((uint16_t)(1<<H_D2Pin))
+#define H_D3 ((uint16_t)(1<<H_D3Pin))
+#define H_D4 ((uint16_t)(1<<H_D4Pin))
+#define H_LEDCtrl ((uint16_t)(1<<H_LEDCtrlPin))
+#define H_ChgPmp ((uint16_t)(1<<H_ChgPmpPin))
+
+//Optional read/write pin. Uncomment H_USE_RW if the
+//HD44780 R/W line is wired to H_RW instead of being
+//tied to ground. The library will then poll the busy
+//flag (on the D7 line, H_D4) between transfers
+//instead of waiting a fixed 1ms per byte. If the
+//module runs from 5V, make sure H_D4 is on a 5V
+//tolerant pin!
+//#define H_USE_RW
+#ifndef H_RWPin
+#define H_RWPin 8
+#endif
+#define H_RW ((uint16_t)(1<<H_RWPin))
+
+//Native 8bit data bus. Uncomment H_BUS8B to use
+//eight consecutive data pins (DB0 on pin H_DB0Pin
+//through DB7 on pin H_DB0Pin+7) of H_DataGPIO
+//instead of the 4bit bus on H_D1..H_D4. Each byte
+//is then written with a single store and a single
+//enable pulse. RS, EN and R/W stay on HD44780_GPIO.
+//As with HD44780_GPIO, overriding H_DataGPIO also
+//requires H_DataRCC.
+//#define H_BUS8B
+#ifndef H_DataGPIO
+#define H_DataGPIO GPIOB
+#define H_DataRCC RCC_AHBPeriph_GPIOB
+#endif
+#ifndef H_DB0Pin
+#define H_DB0Pin 0
+#endif
+#define H_DataPins ((uint16_t)(0xFF<<H_DB0Pin))
+
+#ifdef H_BUS8B
+#define H_BusLength H_DataLength8b
+#define H_BusName "8bit"
+#else
+#define H_BusLength H_DataLength4b
+#define H_BusName "4bit"
+#endif
+
+//Number of loop iterations the enable pin is held
+//for, ~450ns at 48MHz. Increase for faster cores.
+#define H_ENHold 4
+
+//HD44780 instruction classes for the execution time
+//table, one per instruction (0 being H_ClearDisp up
+//to 7 being H_SetDDRamAdd) plus data writes.
+#define H_ExecData		8
+#define H_ExecClasses	9
+
+//Non-blocking output queue. Uncomment H_USE_QUEUE to
+//have the print functions add their bytes to a ring
+//buffer of H_QSize entries (must be a power of 2, at
+//most 256) instead of waiting for the display. The
+//queue is drained by the interrupt of the H_QTIM timer,
+//which fires as each byte finishes executing.
+//Overriding H_QTIM requires the other three timer
+//defines too.
+//#define H_USE_QUEUE
+#ifndef H_QSize
+#define H_QSize		64
+#endif
+#ifndef H_QTIM
+#define H_QTIM			TIM14
+#define H_QTIMRCC		RCC_APB1Periph_TIM14
+#define H_QIRQn			TIM14_IRQn
+#define H_QIRQHandler	TIM14_IRQHandler
+#endif
 
-//HD4780 X pixels
-#define H_XSize 16
+//Display geometry descriptor: the number of columns
+//and rows, and the DDRAM address of the first
+//character of each row.
+typedef struct{
+	uint8_t Cols;
+	uint8_t Rows;
+	uint8_t RowAdd[4];
+} H_Geometry;
+
+//Marquee state: the string, its length, the index of
+//the character at the left of the screen and the row.
+typedef struct{
+	const char* S;
+	uint16_t Len;
+	uint16_t Pos;
+	uint8_t Y;
+} H_Marquee;
+
+//HD4780 X and Y sizes, taken from the geometry in use.
+#define H_XSize (H_Geo->Cols)
+#define H_YSize (H_Geo->Rows)
+
+//Check a row (1 being the first row) is on screen.
+#define H_RowOK(Y) ((uint8_t)((Y)-1)<H_Geo->Rows)
+
+//Length of a DDRAM line, 40 characters on two line
+//displays and 80 on single line displays.
+#define H_LineLen (H_YSize>1?40:80)
 
 //HD44780 Register definitions
 #define H_ClearDisp		0x01
@@ -40,12 +172,12 @@
 #define H_Increment 	(1<<1)
 #define H_Decrement		(0<<1)
 #define H_AccDispShft	(1<<0)
-#define H_DispShift		(1<<4)
-#define H_CurrMove		(0<<4)
-#define H_ShiftRight	(1<<3)
-#define H_ShiftLeft		(0<<3)
-#define H_DataLength8b	(1<<5)
-#define H_DataLength4b	(0<<5)
+#define H_DispShift		(1<<3)
+#define H_CurrMove		(0<<3)
+#define H_ShiftRight	(1<<2)
+#define H_ShiftLeft		(0<<2)
+#define H_DataLength8b	(1<<4)
+#define H_DataLength4b	(0<<4)
 #define H_DispLines2	(1<<3)
 #define H_DispLines1	(0<<3)
 #define H_CharFont5x10	(1<<2)
@@ -60,26 +192,123 @@
 #define H_DispShiftEn	(1<<0)
 
 //Bouncing text define, uncomment this if
-//you wish you see the bouncing text. I'm
-//not using any display shifts for this.
+//you wish you see the bouncing text. The
+//text is moved with display shifts.
 //#define BOUNCING_TEXT
 
+//Benchmark define, uncomment this to time a number
+//of full screen rewrites at startup and display the
+//throughput (characters per second) for the bus mode
+//in use.
+//#define BENCHMARK
+
 //Allow all source and header files using
 //this library to access the LEDBrightness
 //variable.
 extern volatile uint8_t LEDBrightness;
 
+//Enable pin(s) of the selected display(s).
+extern volatile uint16_t H_ENSel;
+
+//Tracked address counter of the selected display.
+#define H_ACUnknown 0xFF
+extern uint8_t H_AC;
+
+//Number of columns the display has been shifted left.
+extern uint8_t H_ShiftOff;
+
+//True if a single enable pin is in the mask.
+#define H_OneDisp(Mask) ((Mask) && !((Mask)&((Mask)-1)))
+
+//Body of the wait loops that depend on interrupts
+//(queue and DMA), overridable for other targets.
+#ifndef H_Idle
+#define H_Idle() asm volatile("nop")
+#endif
+
+//Instruction execution time margin in percent.
+extern volatile uint16_t H_ExecMargin;
+
+//Common display geometries and the one in use,
+//16x2 by default. Change it with H_SetGeometry
+//before calling H_HWInit.
+extern const H_Geometry H_Geo8x1, H_Geo8x2, H_Geo16x2, H_Geo16x4;
+extern const H_Geometry H_Geo20x2, H_Geo20x4, H_Geo40x2;
+extern const H_Geometry* H_Geo;
+
 //Allow the library to access the external Delay
 //function.
 extern void Delay(uint32_t);
 
 //Hardware control functions
 void H_HWInit(void);
+void H_SelDisp(uint16_t);
+void H_SetGeometry(const H_Geometry*);
+uint8_t H_CellAdd(uint8_t, uint8_t);
+void H_Scroll(int8_t);
+int8_t MarqueeInit(H_Marquee*, const char*, uint8_t);
+void MarqueeStep(H_Marquee*);
 void H_LEDPWM(void);
 void H_ChargePump(void);
 
+//Nibble to GPIO BSRR word for the 4bit bus, resolved
+//at compile time. When H_D1..H_D4 are consecutive
+//pins, the nibble is shifted into place and all four
+//pins reset in the same word (set bits take priority
+//over reset bits in BSRR). Otherwise a table of 16
+//precomputed words is used.
+#if (H_D2Pin == H_D1Pin+1) && (H_D3Pin == H_D1Pin+2) && (H_D4Pin == H_D1Pin+3)
+#define H_NibBSRR(N) ((((uint32_t)(N)&15)<<H_D1Pin)|((uint32_t)15<<(H_D1Pin+16)))
+#else
+extern const uint32_t H_NibLUT[16];
+#define H_NibBSRR(N) (H_NibLUT[(N)&15])
+#define H_NibUseLUT
+#endif
+
 //Data control functions
 void H_W8b(uint8_t, uint8_t);
+void H_Bus8b(uint8_t, uint8_t);
+void H_Put(uint8_t, uint8_t);
+void H_Track(uint8_t, uint8_t);
+uint8_t H_SetAdd(uint8_t);
+uint8_t H_DDAdd(void);
+uint8_t H_EntryMode(void);
+uint8_t H_ExecClass(uint8_t, uint8_t);
+uint16_t H_ExecUs(uint8_t, uint8_t);
+uint8_t H_R8b(uint8_t);
+void H_WaitReady(uint16_t);
+void H_DelayUs(uint32_t);
+uint32_t H_TicksSince(uint32_t*);
+
+#ifdef H_USE_QUEUE
+//Output queue functions
+extern volatile uint8_t H_QHighWater;
+void H_QPut(uint8_t, uint8_t);
+void H_QIRQHandler(void);
+void H_QFlush(void);
+uint8_t H_QUsed(void);
+#endif
+
+//Print targets, the display itself or the
+//framebuffer (see HD44780FB.h).
+#define H_TargetLCD	0
+#define H_TargetFB	1
+
+//Print target selection and positioning
+extern uint8_t H_Target;
+void H_SetTarget(uint8_t);
+void H_GoTo(uint8_t, uint8_t);
+void H_PutC(char);
+
+//String helper functions
+uint8_t Strlen(const char*);
+
+//Number helper functions. The magnitude of a number
+//is taken after the conversion to unsigned, -Num would
+//overflow for the most negative number.
+#define H_Mag(Num) ((Num)<0?0u-(uint32_t)(Num):(uint32_t)(Num))
+uint8_t H_UDigits(uint32_t, char*);
+uint8_t CheckNumLength(int32_t);
 
 //Character handling functions
 int8_t PStr(const char*, uint8_t, uint8_t);
@@ -87,6 +316,11 @@ int8_t PChar(char, uint8_t, uint8_t);
 int8_t PNum(int32_t, uint8_t, uint8_t, uint8_t);
 int8_t PNumF(float, uint8_t, uint8_t, uint8_t);
 
+//Fixed width, blank filled character handling functions
+int8_t PStrW(const char*, uint8_t, uint8_t, uint8_t);
+int8_t PNumW(int32_t, uint8_t, uint8_t, uint8_t, uint8_t);
+int8_t PNumFW(float, uint8_t, uint8_t, uint8_t, uint8_t);
+
 //Display control functions
 void ClrDisp(void);
 
@@ -0,0 +1,218 @@
+#include <HD44780Sim.h>
+#include <HostHW.h>
+
+/*
+ * HD44780Sim.c
+ *
+ *A model of the HD44780 as seen from its bus: 8bit and
+ *4bit interfaces, busy flag and address counter reads,
+ *DDRAM/CGRAM, entry mode, cursor and display shifts.
+ *Instruction times are the datasheet values at 270kHz,
+ *any strobe whilst an instruction is still executing is
+ *counted as an error.
+ *
+ *The code is released under the MIT License, see
+ *HD44780LIB.c for the full license text.
+ */
+
+HD_Sim Sim;
+
+//Put the model in its power on state (DL8 = 1) or in
+//the state after a microcontroller only reset (4bit,
+//with Phase nibbles of a byte already received).
+void SimReset(uint8_t DL8, uint8_t Phase){
+	uint8_t Cnt;
+
+	for(Cnt = 0; Cnt<128; Cnt++) Sim.DD[Cnt] = ' ';
+	for(Cnt = 0; Cnt<64; Cnt++) Sim.CGR[Cnt] = 0;
+
+	Sim.DL8 = DL8;
+	Sim.Pend = DL8?0:Phase;
+	Sim.PendVal = 0;
+	Sim.ReadNib = 0;
+	Sim.Lines2 = 0;
+	Sim.ID = 1;
+	Sim.S = 0;
+	Sim.On = 0;
+	Sim.AC = 0;
+	Sim.CG = 0;
+	Sim.Shift = 0;
+	Sim.BusyUntil = 0;
+	Sim.Execs = 0;
+	Sim.BusyErrs = 0;
+	Sim.Contention = 0;
+	Sim.LogLen = 0;
+	Sim.BlankW = 0;
+	Sim.Blank = 0;
+	Sim.BlankNs = 0;
+}
+
+uint8_t SimBusy(void){
+	return HostNs<Sim.BusyUntil;
+}
+
+//Length of a DDRAM line.
+static uint8_t SimLineLen(void){
+	return Sim.Lines2?40:80;
+}
+
+//Step the address counter the way the HD44780 does.
+static void SimStep(uint8_t Inc){
+	if(Sim.CG){
+		Sim.AC = (Sim.AC+(Inc?1:-1))&0x3F;
+	}
+	else if(Sim.Lines2){
+		if(Inc) Sim.AC = Sim.AC == 0x27?0x40:Sim.AC == 0x67?0x00:Sim.AC+1;
+		else Sim.AC = Sim.AC == 0x40?0x27:Sim.AC == 0x00?0x67:Sim.AC-1;
+	}
+	else{
+		if(Inc) Sim.AC = Sim.AC == 0x4F?0x00:Sim.AC+1;
+		else Sim.AC = Sim.AC == 0x00?0x4F:Sim.AC-1;
+	}
+}
+
+//Shift the display one column, left moving the
+//contents left (the first column then shows the next
+//DDRAM position).
+static void SimShift(uint8_t Left){
+	if(Left) Sim.Shift = (Sim.Shift+1)%SimLineLen();
+	else Sim.Shift = Sim.Shift?Sim.Shift-1:SimLineLen()-1;
+}
+
+//Add up the time the watched field shows as blank.
+static void SimBlank(void){
+	char Row[81];
+	uint8_t X, Blank = 1;
+
+	if(!Sim.BlankW) return;
+
+	SimRow(1, Row);
+	for(X = 0; X<Sim.BlankW; X++){
+		if(Row[X] != ' ') Blank = 0;
+	}
+
+	if(Blank && !Sim.Blank) Sim.BlankAt = HostNs;
+	if(!Blank && Sim.Blank) Sim.BlankNs += HostNs-Sim.BlankAt;
+	Sim.Blank = Blank;
+}
+
+//Execute a whole instruction (RS = 0) or data write.
+static void SimExec(uint8_t RS, uint8_t D){
+	uint32_t Ns = 37000;
+	uint8_t Cnt;
+
+	Sim.Execs++;
+	if(Sim.LogLen<SimLogSize) Sim.Log[Sim.LogLen++] = D|(RS?0x100:0);
+
+	if(RS){
+		if(Sim.CG) Sim.CGR[Sim.AC] = D;
+		else Sim.DD[Sim.AC] = D;
+
+		SimStep(Sim.ID);
+		if(Sim.S && !Sim.CG) SimShift(Sim.ID);
+		Ns = 41000;
+	}
+	else if(D&0x80){
+		Sim.AC = D&0x7F;
+		Sim.CG = 0;
+	}
+	else if(D&0x40){
+		Sim.AC = D&0x3F;
+		Sim.CG = 1;
+	}
+	else if(D&0x20){
+		Sim.DL8 = (D>>4)&1;
+		Sim.Lines2 = (D>>3)&1;
+	}
+	else if(D&0x10){
+		//S/C is DB3, R/L is DB2.
+		if(D&0x08) SimShift(!(D&0x04));
+		else SimStep((D>>2)&1);
+	}
+	else if(D&0x08){
+		Sim.On = (D>>2)&1;
+	}
+	else if(D&0x04){
+		Sim.ID = (D>>1)&1;
+		Sim.S = D&1;
+	}
+	else if(D&0x02){
+		Sim.AC = 0;
+		Sim.CG = 0;
+		Sim.Shift = 0;
+		Ns = 1520000;
+	}
+	else if(D&0x01){
+		for(Cnt = 0; Cnt<128; Cnt++) Sim.DD[Cnt] = ' ';
+		Sim.AC = 0;
+		Sim.CG = 0;
+		Sim.ID = 1;
+		Sim.Shift = 0;
+		Ns = 1520000;
+	}
+
+	Sim.BusyUntil = HostNs+Ns;
+	SimBlank();
+}
+
+//Falling enable edge with R/W low. Bus holds DB7..DB0,
+//in 4bit mode only DB7..DB4 are wired.
+void SimWrite(uint8_t RS, uint8_t Bus){
+	if(SimBusy()) Sim.BusyErrs++;
+
+	Sim.ReadNib = 0;
+
+	if(Sim.DL8){
+		SimExec(RS, Bus);
+	}
+	else if(!Sim.Pend){
+		Sim.PendVal = Bus&0xF0;
+		Sim.Pend = 1;
+	}
+	else{
+		Sim.Pend = 0;
+		SimExec(RS, Sim.PendVal|(Bus>>4));
+	}
+}
+
+//Rising enable edge with R/W high, returns what the
+//HD44780 drives onto DB7..DB0.
+uint8_t SimRead(uint8_t RS){
+	uint8_t Val;
+
+	if(Sim.DL8 || !Sim.ReadNib){
+		if(RS){
+			if(SimBusy()) Sim.BusyErrs++;
+			Val = Sim.CG?Sim.CGR[Sim.AC]:Sim.DD[Sim.AC];
+			SimStep(Sim.ID);
+		}
+		else{
+			Val = (SimBusy()?0x80:0)|Sim.AC;
+		}
+
+		if(Sim.DL8) return Val;
+
+		Sim.ReadVal = Val;
+		Sim.ReadNib = 1;
+		return Val&0xF0;
+	}
+
+	Sim.ReadNib = 0;
+	return Sim.ReadVal<<4;
+}
+
+//Copy what row Y (from 1) of the display in use shows
+//into Out, null terminated. Only the size is taken from
+//the library's geometry, the rows are found the way
+//modules are wired: rows 1 and 2 start DDRAM lines 1
+//and 2 (line 2 being at 0x40), rows 3 and 4 carry on
+//from them one row width on.
+void SimRow(uint8_t Y, char* Out){
+	uint8_t Line = (Y-1)&1, Off = ((Y-1)>>1)*H_XSize, X;
+
+	for(X = 0; X<H_XSize; X++){
+		if(Sim.Lines2) Out[X] = Sim.DD[(Line?0x40:0x00)|((Off+X+Sim.Shift)%40)];
+		else Out[X] = Sim.DD[(Off+X+Sim.Shift)%80];
+	}
+	Out[X] = 0;
+}
@@ -0,0 +1,63 @@
+#ifndef HD44780SIM_H
+#define HD44780SIM_H
+
+#include <HD44780LIB.h>
+
+//Simulated HD44780, fed with the enable pulses seen on
+//the host GPIO ports (HostHW.c).
+
+//Size of the log of executed instructions and data
+//writes (bit 8 holding RS).
+#define SimLogSize 1024
+
+typedef struct{
+	//Interface: 8bit mode, 4bit nibble pending (and
+	//its value), nibble of the next 4bit read.
+	uint8_t DL8;
+	uint8_t Pend, PendVal;
+	uint8_t ReadNib, ReadVal;
+
+	//Function set, entry mode and display control.
+	uint8_t Lines2;
+	uint8_t ID, S;
+	uint8_t On;
+
+	//Address counter (CG set if it points into CGRAM)
+	//and display shift, the DDRAM position shown in the
+	//first column.
+	uint8_t AC, CG;
+	uint8_t Shift;
+
+	uint8_t DD[128];
+	uint8_t CGR[64];
+
+	//Simulated time (ns) the current instruction
+	//finishes at.
+	uint64_t BusyUntil;
+
+	//Statistics and errors: bytes executed, strobes and
+	//data reads whilst busy, reads with the data pins
+	//still driven by the microcontroller.
+	uint32_t Execs;
+	uint32_t BusyErrs;
+	uint32_t Contention;
+
+	uint16_t Log[SimLogSize];
+	uint16_t LogLen;
+
+	//Visible blank time: with BlankW set, the time (ns)
+	//the first BlankW columns of row 1 have shown
+	//nothing but spaces.
+	uint8_t BlankW, Blank;
+	uint64_t BlankAt, BlankNs;
+} HD_Sim;
+
+extern HD_Sim Sim;
+
+void SimReset(uint8_t, uint8_t);
+void SimWrite(uint8_t, uint8_t);
+uint8_t SimRead(uint8_t);
+uint8_t SimBusy(void);
+void SimRow(uint8_t, char*);
+
+#endif
@@ -0,0 +1,311 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <HostHW.h>
+#include <HD44780Sim.h>
+
+/*
+ * HostHW.c
+ *
+ *Host versions of the GPIO, RCC and SysTick parts the
+ *HD44780 library uses. Each access advances the
+ *simulated time a little and lets the pins catch up
+ *with the stores made since the last access, enable
+ *edges being passed to the simulated controller.
+ *
+ *The code is released under the MIT License, see
+ *HD44780LIB.c for the full license text.
+ */
+
+//Time taken by a register access and by a call to
+//GPIO_Init, roughly as on a 48MHz Cortex-M0.
+#define HostAccessNs	50
+#define HostInitNs		1000
+
+//SysTick period in ns, as set up in main.c.
+#define HostTickNs		500000
+
+uint64_t HostNs = 0;
+void (*HostTick)(void) = 0;
+void (*HostTimIRQ)(void) = 0;
+uint32_t SystemCoreClock = 48000000;
+
+static GPIO_TypeDef HostPorts[2];
+static SysTick_Type HostSysTickRegs;
+static uint64_t HostNextTick = HostTickNs;
+static uint8_t HostInTick = 0;
+
+//TIM14: counting (enable bit seen set), the time the
+//count was last (re)started and the count it started
+//from, and the time of the next update. CNT reads as
+//HostTimIdle, anything else being a value written by
+//the library.
+#define HostTimIdle		0xFFFFFFFF
+static TIM_TypeDef HostTIM14;
+static uint8_t HostTimRun = 0;
+static uint64_t HostTimBase = 0, HostTimDue = 0;
+static uint32_t HostTimFrom = 0;
+
+//Controller side of the bus: enable level last seen,
+//and the value driven during reads.
+static uint8_t HostLastEN = 0, HostDriving = 0, HostDrive = 0;
+
+TIM_TypeDef HostTIM2;
+DMA_Channel_TypeDef HostDMA1Ch2;
+DMA_TypeDef HostDMA1;
+
+//Reset the ports and time, the SysTick reload being
+//set as in main.c.
+void HostInit(void){
+	uint8_t Cnt;
+
+	for(Cnt = 0; Cnt<2; Cnt++){
+		HostPorts[Cnt].IDR = 0;
+		HostPorts[Cnt].ODR = 0;
+		HostPorts[Cnt].BSRR = 0;
+		HostPorts[Cnt].BRR = 0;
+		HostPorts[Cnt].InMask = 0;
+		HostPorts[Cnt].OutMask = 0;
+	}
+
+	HostSysTickRegs.LOAD = SystemCoreClock/2000-1;
+	HostNs = 0;
+	HostNextTick = HostTickNs;
+	HostLastEN = 0;
+	HostDriving = 0;
+
+	HostTIM14.CR1 = 0;
+	HostTIM14.DIER = 0;
+	HostTIM14.SR = 0;
+	HostTIM14.CNT = HostTimIdle;
+	HostTimRun = 0;
+	HostTimFrom = 0;
+}
+
+//Follow the changes made to TIM14: writing CNT
+//restarts the count from there, setting the enable bit
+//starts counting and ARR applies straight away. An
+//update is due once the count has gone past ARR. With
+//ARR at 0 the counter is blocked, as on the STM32F0,
+//and no update ever comes.
+static void HostTimSync(void){
+	TIM_TypeDef* T = &HostTIM14;
+
+	if(T->CNT != HostTimIdle){
+		HostTimFrom = T->CNT;
+		HostTimBase = HostNs;
+		T->CNT = HostTimIdle;
+	}
+
+	if(!(T->CR1&TIM_CR1_CEN)) HostTimRun = 0;
+	else if(!HostTimRun){
+		HostTimRun = 1;
+		HostTimBase = HostNs;
+	}
+
+	if(!T->ARR) HostTimDue = UINT64_MAX;
+	else HostTimDue = HostTimBase+(uint64_t)(T->ARR+1-HostTimFrom)*(T->PSC+1)*1000/(SystemCoreClock/1000000);
+}
+
+//Run the TIM14 interrupt for as long as it's pending,
+//the update flag being set with the interrupt enabled,
+//unless another interrupt is running.
+static void HostTimPend(void){
+	while(HostTimIRQ && !HostInTick && (HostTIM14.DIER&TIM_DIER_UIE) && (HostTIM14.SR&TIM_SR_UIF)){
+		HostInTick = 1;
+		HostTimIRQ();
+		HostInTick = 0;
+		HostTimSync();
+	}
+}
+
+//Move the simulated time on, running HostTick for
+//every SysTick period passed and the TIM14 interrupt
+//whilst an update is pending. Interrupts don't nest,
+//a TIM14 update during another interrupt (the TIM14
+//one included) sets the update flag and is handled
+//once it returns.
+void HostAdvance(uint64_t Ns){
+	uint64_t End = HostNs+Ns, At;
+
+	HostTimSync();
+
+	for(;;){
+		At = HostNextTick;
+		if(HostTimRun && HostTimDue<At) At = HostTimDue;
+		if(At>End) break;
+
+		if(HostNs<At) HostNs = At;
+
+		if(At == HostNextTick){
+			HostNextTick += HostTickNs;
+
+			if(HostTick && !HostInTick){
+				HostInTick = 1;
+				HostTick();
+				HostInTick = 0;
+			}
+		}
+		else{
+			//The count restarts from 0 on the update.
+			HostTIM14.SR |= TIM_SR_UIF;
+			HostTimFrom = 0;
+			HostTimBase = HostNs;
+		}
+
+		HostTimSync();
+		HostTimPend();
+		if(HostNs>End) End = HostNs;
+	}
+
+	HostNs = End;
+}
+
+//Bus lines DB7..DB0 as driven by the microcontroller.
+static uint8_t HostBusOut(void){
+#ifdef H_BUS8B
+	return (HostPorts[1].ODR&H_DataPins)>>H_DB0Pin;
+#else
+	uint16_t A = HostPorts[0].ODR;
+
+	return ((A&H_D4)?0x80:0)|((A&H_D3)?0x40:0)|((A&H_D2)?0x20:0)|((A&H_D1)?0x10:0);
+#endif
+}
+
+//Apply the stores made since the last access, pass
+//enable edges to the controller and update IDR.
+void HostSync(void){
+	uint16_t A, Drive[2] = {0, 0}, Data;
+	uint8_t Cnt, EN, RS, RW = 0;
+
+	for(Cnt = 0; Cnt<2; Cnt++){
+		HostPorts[Cnt].ODR &= ~(HostPorts[Cnt].BRR|(HostPorts[Cnt].BSRR>>16));
+		HostPorts[Cnt].ODR |= HostPorts[Cnt].BSRR&0xFFFF;
+		HostPorts[Cnt].BSRR = 0;
+		HostPorts[Cnt].BRR = 0;
+	}
+
+	A = HostPorts[0].ODR;
+	EN = (A&H_EN)?1:0;
+	RS = (A&H_RS)?1:0;
+#ifdef H_USE_RW
+	RW = (A&H_RW)?1:0;
+#endif
+
+	if(EN && !HostLastEN && RW){
+		HostDrive = SimRead(RS);
+		HostDriving = 1;
+	}
+	if(!EN && HostLastEN && !RW) SimWrite(RS, HostBusOut());
+	if(!EN || !RW) HostDriving = 0;
+	HostLastEN = EN;
+
+	//Data lines driven by the controller.
+	if(HostDriving){
+#ifdef H_BUS8B
+		Data = H_DataPins;
+		Drive[1] = (uint16_t)HostDrive<<H_DB0Pin;
+		if(Data&~HostPorts[1].InMask) Sim.Contention++;
+#else
+		Data = H_D1|H_D2|H_D3|H_D4;
+		Drive[0] = ((HostDrive&0x80)?H_D4:0)|((HostDrive&0x40)?H_D3:0)|
+				   ((HostDrive&0x20)?H_D2:0)|((HostDrive&0x10)?H_D1:0);
+		if(Data&~HostPorts[0].InMask) Sim.Contention++;
+#endif
+	}
+
+	for(Cnt = 0; Cnt<2; Cnt++){
+		HostPorts[Cnt].IDR = (HostPorts[Cnt].ODR&~HostPorts[Cnt].InMask)|(Drive[Cnt]&HostPorts[Cnt].InMask);
+	}
+}
+
+GPIO_TypeDef* HostPort(uint8_t Port){
+	HostAdvance(HostAccessNs);
+	HostSync();
+	return &HostPorts[Port];
+}
+
+SysTick_Type* HostSysTick(void){
+	uint32_t Reload = HostSysTickRegs.LOAD+1;
+
+	HostAdvance(HostAccessNs);
+	HostSync();
+	HostSysTickRegs.VAL = HostSysTickRegs.LOAD-(uint32_t)((HostNs*(SystemCoreClock/1000000)/1000)%Reload);
+	return &HostSysTickRegs;
+}
+
+TIM_TypeDef* HostTim14(void){
+	HostAdvance(HostAccessNs);
+	HostSync();
+	return &HostTIM14;
+}
+
+//Waiting for an interrupt. If the controller executes
+//nothing for HostStallNs whilst the library keeps
+//waiting, the interrupt is never coming (e.g. a timer
+//that doesn't count), so the checks fail instead of
+//hanging. Calls more than 100us apart are separate
+//waits.
+#define HostStallNs		1000000000ULL
+
+void HostIdle(void){
+	static uint32_t Execs = 0;
+	static uint64_t Since = 0, Last = 0;
+
+	if(HostNs<Last || HostNs-Last>100000) Since = HostNs;
+
+	HostAdvance(HostAccessNs);
+	HostSync();
+	Last = HostNs;
+
+	if(Sim.Execs != Execs){
+		Execs = Sim.Execs;
+		Since = HostNs;
+	}
+	else if(HostNs-Since>HostStallNs){
+		printf("Stalled waiting for an interrupt at %u us\n", (unsigned)(HostNs/1000));
+		exit(1);
+	}
+}
+
+void GPIO_Init(GPIO_TypeDef* G, GPIO_InitTypeDef* Init){
+	if(Init->GPIO_Mode == GPIO_Mode_IN) G->InMask |= Init->GPIO_Pin;
+	else{
+		G->InMask &= ~Init->GPIO_Pin;
+		G->OutMask |= Init->GPIO_Pin;
+	}
+
+	HostAdvance(HostInitNs);
+	HostSync();
+}
+
+void GPIO_SetBits(GPIO_TypeDef* G, uint16_t Pins){
+	G->BSRR = Pins;
+}
+
+void GPIO_ResetBits(GPIO_TypeDef* G, uint16_t Pins){
+	G->BRR = Pins;
+}
+
+void GPIO_WriteBit(GPIO_TypeDef* G, uint16_t Pins, BitAction Val){
+	if(Val) G->BSRR = Pins;
+	else G->BRR = Pins;
+}
+
+uint16_t GPIO_ReadInputData(GPIO_TypeDef* G){
+	HostSync();
+	return G->IDR;
+}
+
+uint8_t GPIO_ReadInputDataBit(GPIO_TypeDef* G, uint16_t Pin){
+	HostSync();
+	return (G->IDR&Pin)?1:0;
+}
+
+void RCC_AHBPeriphClockCmd(uint32_t Periph, FunctionalState State){
+}
+
+void RCC_APB1PeriphClockCmd(uint32_t Periph, FunctionalState State){
+}
+
+void NVIC_EnableIRQ(IRQn_Type IRQ){
+}
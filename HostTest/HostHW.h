@@ -0,0 +1,21 @@
+#ifndef HOSTHW_H
+#define HOSTHW_H
+
+#include <HD44780LIB.h>
+
+//Simulated time in ns, advanced by every peripheral
+//access and by Delay.
+extern uint64_t HostNs;
+
+//Function run every SysTick period (0.5ms) of
+//simulated time, as the SysTick interrupt would be.
+extern void (*HostTick)(void);
+
+//TIM14 update interrupt handler.
+extern void (*HostTimIRQ)(void);
+
+void HostInit(void);
+void HostAdvance(uint64_t);
+void HostSync(void);
+
+#endif
@@ -0,0 +1,1418 @@
+#include <stdio.h>
+#include <string.h>
+#include <HD44780LIB.h>
+#include <HostHW.h>
+#include <HD44780Sim.h>
+#include <HD44780FB.h>
+#include <HD44780DMA.h>
+#include <HD44780GFX.h>
+
+/*
+ * HostTest.c
+ *
+ *Host checks of the HD44780 library against the
+ *simulated controller. Built once per bus/option
+ *combination by the Makefile, "make test" runs them all.
+ *
+ *The code is released under the MIT License, see
+ *HD44780LIB.c for the full license text.
+ */
+
+static int Fails = 0;
+
+#define CHECK(C) do{ if(!(C)){ printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #C); Fails++; } }while(0)
+#define CHECKROW(Y, S) do{ char Row_[81], Want_[81]; SimRow(Y, Row_); PadRow(Want_, S); if(strcmp(Row_, Want_)){ printf("%s:%d: row %d is \"%s\", expected \"%s\"\n", __FILE__, __LINE__, Y, Row_, Want_); Fails++; } }while(0)
+
+//Expected row contents, padded with spaces to the
+//width of the display in use. The checks are written
+//for 16 columns, wider displays show spaces after.
+static void PadRow(char* Want, const char* S){
+	uint8_t X;
+
+	for(X = 0; X<H_XSize && S[X]; X++) Want[X] = S[X];
+	for(; X<H_XSize; X++) Want[X] = ' ';
+	Want[X] = 0;
+}
+
+//Millisecond delay normally found in main.c.
+void Delay(uint32_t Ms){
+	HostAdvance((uint64_t)Ms*1000000);
+}
+
+//Power up (or reset) with the controller in the given
+//state and initialize it.
+static void Start(uint8_t DL8, uint8_t Phase){
+	HostInit();
+	SimReset(DL8, Phase);
+	H_HWInit();
+	HostSync();
+}
+
+//Wait for the output to reach the display.
+static void Done(void){
+#ifdef H_USE_QUEUE
+	H_QFlush();
+#endif
+	HostSync();
+}
+
+//Initialization from power on, and after a reset of
+//the microcontroller alone with the controller left in
+//4bit mode, on either nibble of a byte.
+static void TestInit(void){
+	//Instructions executed, the 8bit function sets
+	//being single writes.
+#ifdef H_BUS8B
+	static const uint16_t Seq[] = {0x30, 0x30, 0x30, 0x38, 0x06, 0x01, 0x0C};
+#else
+	static const uint16_t Seq[] = {0x30, 0x30, 0x30, 0x20, 0x28, 0x06, 0x01, 0x0C};
+#endif
+	uint8_t State, Cnt, Len = sizeof(Seq)/sizeof(Seq[0]);
+
+	for(State = 0; State<3; State++){
+		Start(State == 0, State == 2);
+
+		//From power on, the whole sequence is seen. From
+		//4bit mode the 8bit function sets get paired up
+		//differently (e.g. 0x33, 0x30), the rest is the
+		//same.
+		if(State == 0) CHECK(Sim.LogLen == Len);
+		for(Cnt = 3; Cnt<Len; Cnt++){
+			CHECK(Sim.Log[Sim.LogLen-Len+Cnt] == Seq[Cnt]);
+		}
+
+#ifdef H_BUS8B
+		CHECK(Sim.DL8 == 1);
+
+		//The 4bit data pins are left to the application.
+		CHECK(!(GPIOA->OutMask&(H_D1|H_D2|H_D3|H_D4)));
+		CHECK((GPIOB->OutMask&H_DataPins) == H_DataPins);
+#else
+		CHECK(Sim.DL8 == 0);
+		CHECK(!Sim.Pend);
+#endif
+		CHECK(Sim.Lines2 == 1);
+		CHECK(Sim.On == 1);
+		CHECK(Sim.ID == 1 && Sim.S == 0);
+		CHECK(Sim.BusyErrs == 0);
+		CHECKROW(1, "                ");
+	}
+}
+
+//Printing, and reading back the address counter and
+//data when R/W is wired.
+static void TestPrint(void){
+	char Row[81];
+	uint64_t Ns;
+
+	Start(1, 0);
+
+	PStr("Hello world!", 0, 1);
+	PNum(-1237, 0, 2, 2);
+	Done();
+
+	CHECKROW(1, "Hello world!    ");
+	CHECKROW(2, "-001237         ");
+	CHECK(Sim.BusyErrs == 0);
+
+	//Rows 3 and 4 of four row displays, and the address
+	//counter running on from the end of row 1 into row 3.
+	if(H_YSize>2){
+		PStr("Third", 0, 3);
+		PStr("Fourth", 0, 4);
+		H_SetAdd(H_CellAdd(H_XSize-1, 1));
+		H_Put('<', 1);
+		H_Put('>', 1);
+		Done();
+		CHECK(H_AC == H_CellAdd(1, 3));
+		SimRow(1, Row);
+		CHECK(Row[H_XSize-1] == '<');
+		CHECKROW(3, ">hird           ");
+		CHECKROW(4, "Fourth          ");
+	}
+
+#ifndef H_USE_QUEUE
+	//A clear never takes longer than its execution
+	//time, polling the busy flag or not.
+	Ns = HostNs;
+	ClrDisp();
+	CHECK(HostNs-Ns<=(H_ExecUs(H_ClearDisp, 0)+5)*1000ULL);
+#ifdef H_USE_RW
+	CHECK(HostNs-Ns<1600000);
+#endif
+	PStr("Hello world!", 0, 1);
+	PNum(-1237, 0, 2, 2);
+	Done();
+#endif
+
+#ifdef H_USE_RW
+	//The tracked address counter matches the one read.
+	CHECK((H_R8b(0)&0x7F) == H_AC);
+	CHECK(!(H_R8b(0)&0x80));
+
+	//Data reads move the address counter on too.
+	H_SetAdd(H_CellAdd(6, 1));
+	Done();
+	CHECK(H_R8b(1) == 'w');
+	CHECK(H_R8b(1) == 'o');
+	CHECK((H_R8b(0)&0x7F) == H_AC);
+	CHECK(Sim.Contention == 0);
+	CHECK(Sim.BusyErrs == 0);
+#endif
+}
+
+//The BENCHMARK in main.c in simulated time: 20 full
+//screen rewrites, reported in characters per second.
+static void TestThroughput(void){
+	uint64_t Ns;
+	uint8_t Cnt;
+
+	Start(1, 0);
+
+	Ns = HostNs;
+	for(Cnt = 0; Cnt<20; Cnt++){
+		PStr("0123456789ABCDEF", 0, 1);
+		PStr("FEDCBA9876543210", 0, 2);
+	}
+	Done();
+	Ns = HostNs-Ns;
+
+	CHECKROW(2, "FEDCBA9876543210");
+	CHECK(Sim.BusyErrs == 0);
+	printf("%s bus, %s: %u ch/s\n", H_BusName,
+#ifdef H_USE_RW
+		   "busy flag",
+#else
+		   "fixed delays",
+#endif
+		   (unsigned)(20ULL*2*H_XSize*1000000000/Ns));
+}
+
+//Fixed width fields never print past their end.
+static void TestFields(void){
+	char Row[81];
+
+	Start(1, 0);
+
+	PStr("XXXXXXXXXXXXXXXX", 0, 1);
+	PStr("XXXXXXXXXXXXXXXX", 0, 2);
+
+	CHECK(PStrW("Hello", 0, 1, 3) == 3);
+	CHECK(PNumW(42, 4, 1, 0, 4) == 8);
+	CHECK(PNumFW(1.5f, 9, 1, 2, 5) == 14);
+	Done();
+	CHECKROW(1, "HelX42  X1.50 XX");
+
+	//Sign and padding count towards the width.
+	CHECK(PNumW(-5, 0, 2, 2, 4) == 4);
+	CHECK(PNumW(-5, 4, 2, 3, 4) == -1);
+	CHECK(PNumFW(-1.5f, 9, 2, 2, 4) == -1);
+	Done();
+	CHECKROW(2, "-005    X    XXX");
+
+	//The field is cut short at the edge of the screen.
+	CHECK(PStrW("Edge", H_XSize-2, 1, 8) == H_XSize);
+	CHECK(PNumW(12345, H_XSize-3, 2, 0, 8) == -1);
+	Done();
+	SimRow(1, Row);
+	CHECK(!strcmp(Row+H_XSize-2, "Ed"));
+	SimRow(2, Row);
+	CHECK(!strcmp(Row+H_XSize-3, "   "));
+
+	//PNum itself counts the sign and padding.
+	CHECK(PNum(-5, H_XSize-4, 2, 2) == H_XSize);
+	CHECK(PNum(-5, H_XSize-3, 2, 2) == -1);
+	Done();
+
+	//Ten digit numbers and the most negative number
+	//print in full.
+	CHECK(PNumW(1000000000, 0, 1, 0, 12) == 12);
+	Done();
+	SimRow(1, Row);
+	CHECK(!strncmp(Row, "1000000000  ", 12));
+	CHECK(PNumW(1000000000, 0, 1, 0, 9) == -1);
+	CHECK(PNum((int32_t)0x80000000, 0, 2, 0) == 11);
+	CHECK(PNumW((int32_t)0x80000000, 0, 1, 1, 11) == -1);
+	Done();
+	SimRow(2, Row);
+	CHECK(!strncmp(Row, "-2147483648", 11));
+	CHECK(Sim.BusyErrs == 0);
+}
+
+//The clear then redraw and overwrite in place update
+//patterns of the BENCHMARK in main.c, reporting how long
+//the number is blank on the display over 20 updates.
+static void TestBlankTime(void){
+	uint64_t Ns[2];
+	float Num = 1.01f;
+	uint8_t Mode, Cnt;
+
+	for(Mode = 0; Mode<2; Mode++){
+		Start(1, 0);
+		PNumFW(Num, 0, 1, 3, 8);
+		Done();
+		Sim.BlankW = 8;
+		Sim.Blank = 0;
+
+		for(Cnt = 0; Cnt<20; Cnt++){
+			if(Mode == 0){
+				ClrDisp();
+				PNumF(Num, 0, 1, 3);
+			}
+			else PNumFW(Num, 0, 1, 3, 8);
+			Done();
+			Num*=-1.05f;
+		}
+
+		Ns[Mode] = Sim.BlankNs;
+		CHECK(!Sim.Blank);
+		CHECK(Sim.BusyErrs == 0);
+	}
+
+	CHECK(Ns[0]>=20*1520000ULL);
+	CHECK(Ns[1] == 0);
+	printf("Blank time over 20 updates: clear %u us, overwrite %u us\n", (unsigned)(Ns[0]/1000), (unsigned)(Ns[1]/1000));
+}
+
+#ifdef H_USE_QUEUE
+//Queued printing returns straight away, H_QFlush waits
+//for the queue and the last instruction.
+static void TestQueue(void){
+	uint32_t Execs;
+	uint64_t Ns;
+
+	Start(1, 0);
+
+	Ns = HostNs;
+	PStr("Queued", 0, 1);
+	CHECK(HostNs-Ns<100000);
+	CHECK(H_QUsed()>0);
+
+	Done();
+	CHECK(!SimBusy());
+	CHECKROW(1, "Queued          ");
+
+	//A whole line reaches the display in the time the
+	//controller takes to execute it, 17 bytes of ~45us.
+	Ns = HostNs;
+	PStr("0123456789ABCDEF", 0, 2);
+	Done();
+	CHECK(HostNs-Ns<17*50000);
+	CHECKROW(2, "0123456789ABCDEF");
+
+	//Same again ending with a clear.
+	PStr("Gone", 0, 2);
+	ClrDisp();
+	Done();
+	CHECK(!SimBusy());
+	CHECKROW(2, "                ");
+
+	//A byte queued with the timer stopped goes out on
+	//its own, without H_QFlush. The timer is started
+	//with a period it counts (ARR isn't 0).
+	PChar('Q', 0, 1);
+	HostAdvance(200000);
+	HostSync();
+	CHECK(H_QUsed() == 0 && !(TIM14->CR1&TIM_CR1_CEN));
+	CHECKROW(1, "Q               ");
+
+	//The handler run with no update pending sends
+	//nothing, the entry waits for the one in progress.
+	Execs = Sim.Execs;
+	H_QPut('R', 1);
+	HostAdvance(5000);
+	H_QPut('S', 1);
+	H_QIRQHandler();
+	HostSync();
+	CHECK(Sim.Execs == Execs+1);
+	Done();
+	CHECK(Sim.Execs == Execs+2);
+	CHECKROW(1, "QRS             ");
+	CHECK(Sim.BusyErrs == 0);
+}
+#endif
+
+#ifdef H_USE_FB
+//Initializing with the framebuffer as the print target
+//still clears the display, which FBInit relies on.
+static void TestFBInit(void){
+	uint8_t Cnt;
+
+	HostInit();
+	SimReset(1, 0);
+
+	//Left over from before a reset.
+	for(Cnt = 0; Cnt<128; Cnt++) Sim.DD[Cnt] = 'X';
+
+	H_SetTarget(H_TargetFB);
+	H_HWInit();
+	FBInit();
+	Done();
+	CHECKROW(1, "                ");
+	CHECKROW(2, "                ");
+
+	//Drawing only reaches the display on a flush.
+	PStr("Frame", 0, 1);
+	Done();
+	CHECKROW(1, "                ");
+	FBFlush();
+	Done();
+	CHECKROW(1, "Frame           ");
+	CHECK(Sim.BusyErrs == 0);
+
+	H_SetTarget(H_TargetLCD);
+}
+
+//Check that the display shows the framebuffer.
+static uint8_t FBShown(void){
+	char Row[81];
+	uint8_t Y;
+
+	for(Y = 1; Y<=H_YSize; Y++){
+		SimRow(Y, Row);
+		if(memcmp(Row, FB+(Y-1)*H_XSize, H_XSize)) return 0;
+	}
+	return 1;
+}
+
+//Scrolling the display leaves the whole framebuffer to
+//resend, a budgeted flush loop driven by FBBacklog
+//sends it without any other flush first.
+static void TestFBScroll(void){
+	uint8_t Calls = 0;
+
+	Start(1, 0);
+	FBInit();
+	H_SetTarget(H_TargetFB);
+
+	PStr("Scrolled", 0, 1);
+	PStr("away", 4, 2);
+	FBFlush();
+	Done();
+	CHECK(FBShown());
+	CHECK(FBBacklog() == 0);
+
+	H_SetTarget(H_TargetLCD);
+	H_Scroll(1);
+	Done();
+	CHECK(FBBacklog() == H_XSize*H_YSize);
+	CHECK(FBBacklogUs()>0);
+
+	while(FBBacklog() && Calls<100){
+		FBFlushN(4);
+		Calls++;
+	}
+	Done();
+	CHECK(FBShown());
+	CHECK(Sim.BusyErrs == 0);
+}
+
+//Pseudo random numbers for the randomised checks, the
+//same sequence every run.
+static uint32_t RandState = 1;
+
+static uint16_t Rand(uint16_t Max){
+	RandState = RandState*1103515245UL+12345;
+	return (RandState>>16)%Max;
+}
+
+//Random drawing, scrolling and flushes with small
+//budgets. Each flush stays within its budget, and the
+//display ends up showing the framebuffer once the
+//backlog has been sent.
+static void TestFBFlushN(void){
+	static const char Chars[] = "ab #";
+	uint16_t Step, Budget, Sent, Over = 0;
+	uint8_t Calls;
+
+	Start(1, 0);
+	FBInit();
+	H_SetTarget(H_TargetFB);
+
+	for(Step = 0; Step<400; Step++){
+		switch(Rand(8)){
+		case 0:
+			H_SetTarget(H_TargetLCD);
+			H_Scroll(Rand(2)?1:-1);
+			H_SetTarget(H_TargetFB);
+			break;
+		case 1:
+			PStr("Text", Rand(H_XSize-3), 1+Rand(H_YSize));
+			break;
+		default:
+			PChar(Chars[Rand(4)], Rand(H_XSize), 1+Rand(H_YSize));
+			break;
+		}
+
+		Budget = 2+Rand(6);
+		Sent = FBFlushN(Budget);
+		if(Sent>Budget) Over++;
+	}
+	CHECK(Over == 0);
+
+	for(Calls = 0; FBBacklog() && Calls<200; Calls++){
+		FBFlushN(3);
+	}
+	Done();
+	CHECK(FBBacklog() == 0);
+	CHECK(FBShown());
+
+	//A scroll with nothing else to send, the backlog
+	//loop alone has to repair the display.
+	H_SetTarget(H_TargetLCD);
+	H_Scroll(1);
+	H_SetTarget(H_TargetFB);
+
+	for(Calls = 0; FBBacklog() && Calls<200; Calls++){
+		FBFlushN(3);
+	}
+	Done();
+	CHECK(FBShown());
+
+	//FBTick sends FBTickBudget bytes a call.
+	FBClear();
+	PStr("Ticked", 2, 2);
+	FBTickBudget = 4;
+	for(Calls = 0; FBBacklog() && Calls<50; Calls++){
+		Step = Sim.Execs;
+		FBTick();
+		Done();
+		if(Sim.Execs-Step>4) Over++;
+	}
+	CHECK(Over == 0);
+	CHECK(Calls>1);
+	CHECK(FBShown());
+	CHECK(Sim.BusyErrs == 0);
+
+	H_SetTarget(H_TargetLCD);
+}
+
+//Instructions and data writes logged since From.
+static void LogCount(uint16_t From, uint8_t* Cmds, uint8_t* Data){
+	*Cmds = 0;
+	*Data = 0;
+	for(; From<Sim.LogLen; From++){
+		if(Sim.Log[From]&0x100) (*Data)++;
+		else (*Cmds)++;
+	}
+}
+
+//The flush planner resends unchanged characters to
+//bridge a gap when that's cheaper than an address
+//instruction, but never across the jump between rows.
+static void TestFBPlanner(void){
+	uint16_t From;
+	uint8_t Cmds, Data;
+
+	Start(1, 0);
+	FBInit();
+	H_SetTarget(H_TargetFB);
+
+	//With the datasheet costs, an address instruction
+	//(40us) is cheaper than resending a character
+	//(45us).
+	PChar('A', 2, 1);
+	PChar('B', 4, 1);
+	From = Sim.LogLen;
+	FBFlush();
+	Done();
+	LogCount(From, &Cmds, &Data);
+	CHECK(Cmds == 2 && Data == 2);
+	CHECKROW(1, "  A B           ");
+
+	//A slow transport makes a short gap worth filling:
+	//an address (the address counter is 5 characters
+	//away), then the space between the changes.
+	FBCostCmd = 100;
+	PChar('C', H_XSize-6, 1);
+	PChar('D', H_XSize-4, 1);
+	From = Sim.LogLen;
+	FBFlush();
+	Done();
+	LogCount(From, &Cmds, &Data);
+	CHECK(Cmds == 1 && Data == 3);
+	CHECK(Sim.Log[From] == (H_SetDDRamAdd|(H_XSize-6)));
+	CHECK(FBShown());
+
+	//The gap up to the end of row 1 is filled, but the
+	//start of row 2 isn't next to it in DDRAM.
+	PChar('E', H_XSize-1, 1);
+	PChar('F', 0, 2);
+	From = Sim.LogLen;
+	FBFlush();
+	Done();
+	LogCount(From, &Cmds, &Data);
+	CHECK(Cmds == 1 && Data == 4);
+	CHECK(Sim.Log[From+3] == (H_SetDDRamAdd|0x40));
+	CHECK(FBShown());
+
+	//On four row displays, row 3 carries on from the end
+	//of row 1 in DDRAM. The two are sent as one run, the
+	//gap between them being filled.
+	if(H_YSize>2){
+		PChar('e', H_XSize-2, 1);
+		PChar('G', 0, 3);
+		From = Sim.LogLen;
+		FBFlush();
+		Done();
+		LogCount(From, &Cmds, &Data);
+		CHECK(Cmds == 1 && Data == 3);
+		CHECK(Sim.Log[From] == (H_SetDDRamAdd|(H_XSize-2)));
+		CHECK(FBShown());
+	}
+
+	FBCostCmd = H_ExecUs(H_SetDDRamAdd, 0);
+	CHECK(Sim.BusyErrs == 0);
+	H_SetTarget(H_TargetLCD);
+}
+
+//Flushing whatever the entry mode: in decrement mode
+//every character gets its address, and with the entry
+//mode display shift on, the flush writes unshifted
+//and leaves the entry mode as it was.
+static void TestFBEntryMode(void){
+	uint8_t Calls;
+
+	Start(1, 0);
+	FBInit();
+	H_SetTarget(H_TargetFB);
+
+	H_Put(H_EntryModeSet|H_Decrement, 0);
+	PStr("ABCD", 0, 1);
+	FBFlush();
+	Done();
+	CHECKROW(1, "ABCD            ");
+
+	//No gap filling either, it would go backwards.
+	FBCostCmd = 100;
+	PChar('x', 6, 1);
+	PChar('y', 8, 1);
+	FBFlush();
+	Done();
+	CHECKROW(1, "ABCD  x y       ");
+	CHECK(FBShown());
+	FBCostCmd = H_ExecUs(H_SetDDRamAdd, 0);
+
+	H_Put(H_EntryModeSet|H_Increment|H_DispShiftEn, 0);
+	PStr("Shift", 0, 2);
+	FBFlush();
+	Done();
+	CHECKROW(2, "Shift           ");
+	CHECK(FBShown());
+	CHECK(H_ShiftOff == 0 && Sim.Shift == 0);
+	CHECK(Sim.S == 1 && Sim.ID == 1);
+
+	//The same in budgeted steps.
+	PStr("Budget", 0, 1);
+	for(Calls = 0; FBBacklog() && Calls<50; Calls++){
+		FBFlushN(4);
+	}
+	Done();
+	CHECK(FBShown());
+	CHECK(H_ShiftOff == 0 && Sim.Shift == 0 && Sim.S == 1);
+
+	H_Put(H_EntryModeSet|H_Increment|H_DispShiftDis, 0);
+	Done();
+	CHECK(Sim.BusyErrs == 0);
+	H_SetTarget(H_TargetLCD);
+}
+
+//Double buffering: drawing only reaches the display
+//once committed, and carries on from the frame
+//committed.
+static void TestFBCommit(void){
+	char Row[81];
+
+	Start(1, 0);
+	FBInit();
+	H_SetTarget(H_TargetFB);
+	FBSetDouble(1);
+
+	PStr("Frame 1", 0, 1);
+	CHECK(FBFlush() == 0);
+	FBCommit();
+	FBFlush();
+	Done();
+	CHECKROW(1, "Frame 1         ");
+
+	//Commit half way through drawing the next frame,
+	//only the half drawn is sent.
+	PStr("Half", 0, 2);
+	FBCommit();
+	PStr("Frame 2", 0, 1);
+	FBFlushN(3);
+	FBFlush();
+	Done();
+	CHECKROW(1, "Frame 1         ");
+	CHECKROW(2, "Half            ");
+	CHECK(FBShown());
+
+	FBCommit();
+	FBFlush();
+	Done();
+	CHECKROW(1, "Frame 2         ");
+	CHECKROW(2, "Half            ");
+
+	//The back buffer holds the committed frame.
+	PChar('!', 7, 1);
+	FBCommit();
+	FBFlush();
+	Done();
+	CHECKROW(1, "Frame 2!        ");
+	CHECKROW(2, "Half            ");
+	CHECK(Sim.BusyErrs == 0);
+
+	FBSetDouble(0);
+	H_SetTarget(H_TargetLCD);
+}
+
+//Blinking cells: a phase change resends only the cells
+//that blink or swap text, in the same flush as any
+//other change.
+static void TestFBBlink(void){
+	FBRegion R = {12, 2, 4, 1, 1};
+	uint8_t Cmds, Data, N;
+	uint16_t From;
+
+	Start(1, 0);
+	FBInit();
+	H_SetTarget(H_TargetFB);
+
+	PStr("Alarm 12:00", 0, 1);
+	PStr("Temp", 0, 2);
+	FBSetAttr(0, 1, 5, FB_Blink, ' ');
+	FBSetAttr(0, 2, 4, FB_Blink, ' ');
+	FBSetAltStr(0, 2, "Rain");
+	FBFlush();
+	Done();
+	CHECKROW(1, "Alarm 12:00     ");
+	CHECKROW(2, "Temp            ");
+
+	//The phase flips every FBBlinkMs ticks.
+	FBBlinkMs = 2;
+	FBBlinkTick();
+	CHECK(FBPhase == 0);
+	FBBlinkTick();
+	CHECK(FBPhase == 1);
+
+	//5 blanked characters, 4 swapped ones and the
+	//changed digit, all in one flush.
+	PChar('5', 10, 1);
+	From = Sim.LogLen;
+	FBFlush();
+	Done();
+	LogCount(From, &Cmds, &Data);
+	CHECK(Data == 10);
+	CHECK(FBBacklog() == 0);
+	CHECKROW(1, "      12:05     ");
+	CHECKROW(2, "Rain            ");
+
+	//Back again, nothing else having changed.
+	for(N = 0; N<2; N++) FBBlinkTick();
+	CHECK(FBPhase == 0);
+	From = Sim.LogLen;
+	FBFlush();
+	Done();
+	LogCount(From, &Cmds, &Data);
+	CHECK(Data == 9);
+	CHECKROW(1, "Alarm 12:05     ");
+	CHECKROW(2, "Temp            ");
+
+	//Region attributes only cover the cells the region
+	//shows. Spaces blink to spaces, so aren't resent.
+	FBSetAttr(0, 1, H_XSize, 0, ' ');
+	FBSetAttr(0, 2, H_XSize, 0, ' ');
+	CHECK(FBRegionAdd(&R) == 0);
+	RStr(&R, "ON", 0, 1);
+	RAttr(&R, FB_Blink, ' ');
+	FBFlush();
+	Done();
+	CHECKROW(2, "Temp        ON  ");
+
+	for(N = 0; N<2; N++) FBBlinkTick();
+	From = Sim.LogLen;
+	FBFlush();
+	Done();
+	LogCount(From, &Cmds, &Data);
+	CHECK(Data == 2);
+	CHECKROW(1, "Alarm 12:05     ");
+	CHECKROW(2, "Temp            ");
+	CHECK(Sim.BusyErrs == 0);
+
+	for(N = 0; N<2; N++) FBBlinkTick();
+	CHECK(FBPhase == 0);
+	FBBlinkMs = 500;
+	RAttr(&R, 0, ' ');
+	FBRegionRemove(&R);
+	H_SetTarget(H_TargetLCD);
+}
+
+//Overlapping regions with equal Z keep the same owner
+//whatever the order they were added or rebuilt in.
+static void TestFBRegions(void){
+	FBRegion A = {0, 1, 8, 1, 1}, B = {4, 1, 8, 1, 1};
+	FBRegion C = {0, 1, 8, 1, 1}, D = {0, 2, 4, 1, 0};
+	uint8_t Pass;
+
+	Start(1, 0);
+	FBInit();
+	H_SetTarget(H_TargetFB);
+
+	//C reuses A's slot, so gets a lower ID than B.
+	CHECK(FBRegionAdd(&A) == 0);
+	CHECK(FBRegionAdd(&B) == 0);
+	FBRegionRemove(&A);
+	CHECK(FBRegionAdd(&C) == 0);
+	CHECK(FBRegionAdd(&D) == 0);
+	CHECK(C.ID<B.ID);
+
+	//Removing the unrelated region D rebuilds the
+	//owners, B keeps the overlap.
+	for(Pass = 0; Pass<2; Pass++){
+		if(Pass) FBRegionRemove(&D);
+
+		RStr(&C, "CCCCCCCC", 0, 1);
+		RStr(&B, "BBBBBBBB", 0, 1);
+		FBFlush();
+		Done();
+		CHECKROW(1, "CCCCBBBBBBBB    ");
+	}
+
+	//The most negative number prints in full.
+	RClear(&C);
+	D.W = 16;
+	CHECK(FBRegionAdd(&D) == 0);
+	RNum(&D, (int32_t)0x80000000, 0, 1, 0);
+	FBFlush();
+	Done();
+	CHECKROW(2, "-2147483648     ");
+
+	FBRegionRemove(&B);
+	FBRegionRemove(&C);
+	FBRegionRemove(&D);
+	H_SetTarget(H_TargetLCD);
+}
+#endif
+
+#ifdef H_USE_DMA
+void DMA1_Channel2_3_IRQHandler(void);
+
+static uint8_t DMADoneCnt = 0;
+
+static void DMADone(void){
+	DMADoneCnt++;
+}
+
+//Check the words for one byte at H_DMABuf[At]: nibbles
+//with RS, enable high and low, then Idle idle words.
+static void CheckDMAByte(uint16_t At, uint8_t Data, uint8_t RD, uint16_t Idle){
+	uint32_t RSWord = RD?(uint32_t)H_RS:((uint32_t)H_RS<<16);
+	uint16_t Cnt;
+
+	CHECK(H_DMABuf[At] == (H_NibBSRR(Data>>4)|RSWord));
+	CHECK(H_DMABuf[At+1] == H_EN);
+	CHECK(H_DMABuf[At+2] == (uint32_t)H_EN<<16);
+	CHECK(H_DMABuf[At+3] == (H_NibBSRR(Data)|RSWord));
+	CHECK(H_DMABuf[At+4] == H_EN);
+	CHECK(H_DMABuf[At+5] == (uint32_t)H_EN<<16);
+
+	for(Cnt = 0; Cnt<Idle; Cnt++){
+		CHECK(H_DMABuf[At+6+Cnt] == 0);
+	}
+}
+
+//Clock the waveform buffer into the port as TIM2 and
+//the DMA would, then run the completion interrupt.
+static void PlayDMA(void){
+	uint16_t Cnt;
+
+	CHECK(H_DMAStart() == 0);
+	CHECK(H_DMAStart() == -1);
+
+	for(Cnt = 0; Cnt<H_DMALen; Cnt++){
+		GPIOA->BSRR = H_DMABuf[Cnt];
+		HostAdvance(H_DMATickUs*1000);
+	}
+	HostSync();
+
+	HostDMA1.ISR = DMA_ISR_TCIF2;
+	DMA1_Channel2_3_IRQHandler();
+	CHECK(!H_DMABusy);
+}
+
+//The generated word stream, and what it does to the
+//display.
+static void TestDMA(void){
+	Start(1, 0);
+	H_DMADone = DMADone;
+
+	//The prescaler is loaded by a forced update.
+	TIM2->EGR = 0;
+	H_DMAInit();
+	CHECK(TIM2->PSC == 47 && TIM2->ARR == H_DMATickUs-1);
+	CHECK(TIM2->EGR == TIM_EGR_UG);
+
+	//37us instructions (40us with the margin) need 4
+	//ticks, the next enable pulse rising 2 ticks into
+	//the following byte.
+	H_DMAClear();
+	CHECK(H_DMAAdd(H_SetDDRamAdd|0x05, 0) == 0);
+	CHECK(H_DMALen == 6+2);
+	CheckDMAByte(0, H_SetDDRamAdd|0x05, 0, 2);
+
+	//Data writes, 45us.
+	CHECK(H_DMAAdd('A', 1) == 0);
+	CHECK(H_DMALen == 8+6+3);
+	CheckDMAByte(8, 'A', 1, 3);
+	PlayDMA();
+	CHECKROW(1, "     A          ");
+
+	//1.52ms (1672us) instructions, 168 ticks.
+	H_DMAClear();
+	CHECK(H_DMAAdd(H_ClearDisp, 0) == 0);
+	CHECK(H_DMALen == 6+166);
+	CheckDMAByte(0, H_ClearDisp, 0, 166);
+	CHECK(H_DMAStr("DMA", 2, 2) == 5);
+	PlayDMA();
+	CHECKROW(1, "                ");
+	CHECKROW(2, "  DMA           ");
+	CHECK(H_AC == H_CellAdd(5, 2));
+
+	//Shifts and clears sent through the buffer are
+	//tracked like any other write.
+	H_DMAClear();
+	CHECK(H_DMAAdd(H_CurDispShft|H_DispShift|H_ShiftRight, 0) == 0);
+	PlayDMA();
+	CHECK(H_ShiftOff == Sim.Shift && Sim.Shift != 0);
+	H_DMAClear();
+	CHECK(H_DMAAdd(H_ClearDisp, 0) == 0);
+	PlayDMA();
+	CHECK(H_ShiftOff == 0 && Sim.Shift == 0 && H_AC == 0);
+
+	//The buffer refuses what it can't hold.
+	H_DMAClear();
+	CHECK(H_DMAAdd(H_ClearDisp, 0) == 0);
+	CHECK(H_DMAAdd(H_ClearDisp, 0) == -1);
+	CHECK(H_DMALen == 6+166);
+
+	CHECK(DMADoneCnt == 4);
+	CHECK(Sim.BusyErrs == 0);
+}
+#endif
+
+//Display shifts move the contents the way asked and
+//the library follows the offset, so later prints still
+//land on screen positions.
+static void TestScroll(void){
+	char Row[81];
+
+	Start(1, 0);
+
+	PStr("Hello", 0, 2);
+	H_Scroll(1);
+	Done();
+	CHECKROW(2, " Hello          ");
+	CHECK(H_ShiftOff == Sim.Shift);
+
+	H_Scroll(-3);
+	Done();
+	CHECKROW(2, "llo             ");
+	CHECK(H_ShiftOff == Sim.Shift);
+
+	PStr("AB", 0, 1);
+	PChar('Z', H_XSize-1, 2);
+	Done();
+	CHECKROW(1, "AB              ");
+	SimRow(2, Row);
+	CHECK(!strncmp(Row, "llo ", 4) && Row[H_XSize-1] == 'Z');
+
+	//Cursor moves aren't display shifts.
+	H_Put(H_CurDispShft|H_CurrMove|H_ShiftRight, 0);
+	Done();
+	CHECK(H_ShiftOff == Sim.Shift);
+	PChar('C', 2, 1);
+	Done();
+	CHECKROW(1, "ABC             ");
+
+#ifdef H_USE_RW
+	CHECK((H_R8b(0)&0x7F) == H_AC);
+#endif
+
+	//Return home undoes the shift, Z was written two
+	//columns past the screen.
+	H_Put(H_RetHome, 0);
+	Done();
+	CHECKROW(2, "Hello           ");
+	CHECK(H_ShiftOff == 0 && Sim.Shift == 0);
+
+	//With the entry mode display shift on, each
+	//character written shifts the display too. Z goes to
+	//the first column and is then shifted off it.
+	H_Put(H_EntryModeSet|H_Increment|H_DispShiftEn, 0);
+	PStr("abc", 0, 1);
+	PChar('Z', 0, 2);
+	Done();
+	CHECK(H_ShiftOff == 4 && Sim.Shift == 4);
+	CHECK(Sim.DD[0x43] == 'Z');
+
+	H_Put(H_EntryModeSet|H_Increment|H_DispShiftDis, 0);
+	PChar('Y', 0, 2);
+	Done();
+	CHECK(H_ShiftOff == Sim.Shift);
+	SimRow(2, Row);
+	CHECK(Row[0] == 'Y');
+	CHECK(Sim.BusyErrs == 0);
+}
+
+//Each display keeps its own shift when several share
+//the bus. Only the display on H_EN is simulated, the
+//other enable pins go nowhere.
+static void TestSelDisp(void){
+	uint16_t Other = H_ENAll&~H_EN;
+
+	if(!Other) return;
+
+	Start(1, 0);
+
+	H_SelDisp(Other);
+	H_Scroll(2);
+	CHECK(H_ShiftOff == H_LineLen-2);
+
+	H_SelDisp(H_EN);
+	CHECK(H_ShiftOff == 0);
+	PStr("First", 0, 1);
+	H_Scroll(-1);
+	Done();
+	CHECKROW(1, "irst            ");
+
+	H_SelDisp(Other);
+	CHECK(H_ShiftOff == H_LineLen-2);
+
+	H_SelDisp(H_EN);
+	CHECK(H_ShiftOff == Sim.Shift);
+	PChar('X', 0, 2);
+	Done();
+	CHECKROW(2, "X               ");
+	CHECK(Sim.BusyErrs == 0);
+}
+
+//Marquees move one character per step, the character
+//coming into view being the next one of the string.
+static void TestMarquee(void){
+	static const char* const Strs[] = {"Hi! ", "0123456789 abcdefghijklmnopqrstuvwxyz ABCDEFGHIJKL "};
+	char Row[81], Want[81];
+	uint8_t Str, X, Bad;
+	uint16_t Step, Len;
+	H_Marquee M;
+
+	//Four row displays are refused, rows 1 and 3 sharing
+	//a DDRAM line.
+	if(H_YSize>2){
+		Start(1, 0);
+		CHECK(MarqueeInit(&M, Strs[0], 1) == -1);
+		MarqueeStep(&M);
+		Done();
+		CHECK(H_ShiftOff == 0 && Sim.Shift == 0);
+		CHECKROW(1, "                ");
+		CHECKROW(3, "                ");
+		return;
+	}
+
+	for(Str = 0; Str<2; Str++){
+		Start(1, 0);
+		Len = Strlen(Strs[Str]);
+		CHECK(MarqueeInit(&M, Strs[Str], 2) == 0);
+
+		Bad = 0;
+		for(Step = 0; Step<=120; Step++){
+			if(Step) MarqueeStep(&M);
+			Done();
+
+			for(X = 0; X<H_XSize; X++){
+				Want[X] = Strs[Str][(Step+X)%Len];
+			}
+			Want[X] = 0;
+
+			SimRow(2, Row);
+			if(strcmp(Row, Want)) Bad++;
+
+			//The cell that just left the screen on the
+			//left holds the character one line length on.
+			if(Sim.DD[0x40|((Sim.Shift+39)%40)] != Strs[Str][(Step+39)%Len]) Bad++;
+			CHECK(H_ShiftOff == Sim.Shift);
+		}
+
+		CHECK(Bad == 0);
+		CHECK(Sim.BusyErrs == 0);
+	}
+}
+
+#ifdef H_USE_CG
+//Big digits: segments uploaded once, only changed
+//digits redrawn.
+static void TestBigNum(void){
+	H_BigNum B;
+	uint32_t Execs;
+	uint8_t Slot;
+
+	Start(1, 0);
+	CGInit();
+	CHECK(BigFontInit() == 0);
+	HostSync();
+
+	//Top bar, bottom bar and both in the first 3 slots.
+	for(Slot = 0; Slot<3; Slot++){
+		CHECK(Sim.CGR[Slot*8] == (Slot == 1 ? 0x00 : 0x1F));
+		CHECK(Sim.CGR[Slot*8+7] == (Slot == 0 ? 0x00 : 0x1F));
+	}
+
+	CHECK(BigInit(&B, 0, 1, 4) == 0);
+	CHECK(BigNum(&B, 1234, 0) == 15);
+	Done();
+
+	//Digit 1: top bar, block, space over bottom bar,
+	//block, bottom bar.
+	CHECK(Sim.DD[0x00] == H_CGCode(0) && Sim.DD[0x01] == 0xFF && Sim.DD[0x02] == ' ');
+	CHECK(Sim.DD[0x40] == H_CGCode(1) && Sim.DD[0x41] == 0xFF && Sim.DD[0x42] == H_CGCode(1));
+
+	//One digit changes: an address and 3 characters
+	//per row.
+	Execs = Sim.Execs;
+	BigNum(&B, 1235, 0);
+	Done();
+	CHECK(Sim.Execs-Execs == 8);
+
+	//Nothing changes.
+	Execs = Sim.Execs;
+	BigNum(&B, 1235, 0);
+	Done();
+	CHECK(Sim.Execs == Execs);
+
+	CHECK(BigNum(&B, -123, 0) == 15);
+	CHECK(BigNum(&B, (int32_t)0x80000000, 0) == -1);
+	CHECK(Sim.BusyErrs == 0);
+}
+
+//Data writes for a bar graph change.
+static uint16_t BarWrites(H_Bar* B, uint16_t Val){
+	uint16_t Cnt, From = Sim.LogLen, Data = 0;
+
+	BarSet(B, Val);
+	Done();
+
+	for(Cnt = From; Cnt<Sim.LogLen; Cnt++){
+		if(Sim.Log[Cnt]&0x100) Data++;
+	}
+	return Data;
+}
+
+//Bar graphs only rewrite the cells between the old and
+//new ends.
+static void TestBar(void){
+	H_Bar B;
+	uint8_t Part2;
+
+	Start(1, 0);
+	CGInit();
+	CHECK(BarFontInit() == 0);
+	CHECK(BarInit(&B, 0, 2, 16) == 0);
+
+	//The first set draws the whole bar.
+	CHECK(BarWrites(&B, 12) == 16);
+	Part2 = Sim.DD[0x42];
+	CHECK(Sim.DD[0x40] == 0xFF && Sim.DD[0x41] == 0xFF && Sim.DD[0x43] == ' ');
+	CHECK(Sim.CGR[(Part2&7)*8] == 0x18);
+
+	//Within a cell, onto and off a cell boundary: one
+	//character.
+	CHECK(BarWrites(&B, 13) == 1);
+	CHECK(BarWrites(&B, 15) == 1);
+	CHECK(Sim.DD[0x42] == 0xFF);
+	CHECK(BarWrites(&B, 10) == 1);
+	CHECK(Sim.DD[0x41] == 0xFF && Sim.DD[0x42] == ' ');
+	CHECK(BarWrites(&B, 11) == 1);
+
+	//Across a boundary, both cells.
+	CHECK(BarWrites(&B, 9) == 2);
+	CHECK(Sim.DD[0x41] != 0xFF && Sim.DD[0x42] == ' ');
+
+	//Full and empty.
+	BarWrites(&B, 80);
+	CHECK(Sim.DD[0x4F] == 0xFF);
+	CHECK(BarWrites(&B, 0) == 16);
+	CHECK(Sim.DD[0x40] == ' ');
+	CHECK(Sim.BusyErrs == 0);
+}
+#endif
+
+#ifdef H_USE_CG
+//Glyphs 0 to 7 of a set of distinct test glyphs.
+static void TestGlyph(uint8_t* Glyph, uint8_t N){
+	uint8_t Row;
+
+	for(Row = 0; Row<8; Row++){
+		Glyph[Row] = Row == (N&7) ? 0x1F : N>>3;
+	}
+}
+
+//The least recently used unpinned slot is replaced,
+//new glyphs are uploaded together (one CGRAM address
+//per run of consecutive slots) and the characters on
+//screen using a replaced slot are found.
+static void TestCGCache(void){
+	uint8_t Glyph[8], Cells[8], N, Cmds, Data;
+	uint16_t From;
+
+	Start(1, 0);
+	FBInit();
+	CGInit();
+	H_SetTarget(H_TargetFB);
+
+	//Free slots are used in order, all uploaded as one
+	//block.
+	for(N = 0; N<H_CGSlots; N++){
+		TestGlyph(Glyph, N);
+		CHECK(CGGet(Glyph) == H_CGCode(N));
+	}
+	From = Sim.LogLen;
+	CGUpload();
+	Done();
+	LogCount(From, &Cmds, &Data);
+	CHECK(Cmds == 1 && Data == 64);
+	CHECK(Sim.Log[From] == H_SetCGRAMAdd);
+	CHECK(Sim.CGR[5*8+5] == 0x1F);
+
+	PChar(H_CGCode(1), 0, 1);
+	PChar(H_CGCode(5), 1, 1);
+	PChar(H_CGCode(1), 3, 2);
+	FBFlush();
+	Done();
+
+	//Glyph 0 is used again, so glyph 1 is the least
+	//recently used. Pinned slot 3 is skipped over.
+	TestGlyph(Glyph, 0);
+	CHECK(CGGet(Glyph) == H_CGCode(0));
+	CGPin(H_CGCode(3), 1);
+
+	TestGlyph(Glyph, 8);
+	CHECK(CGGet(Glyph) == H_CGCode(1));
+	TestGlyph(Glyph, 9);
+	CHECK(CGGet(Glyph) == H_CGCode(2));
+	TestGlyph(Glyph, 10);
+	CHECK(CGGet(Glyph) == H_CGCode(4));
+	CHECK(CGStaleMask == ((1<<1)|(1<<2)|(1<<4)));
+
+	//Slots 1 and 2 as one block, slot 4 on its own.
+	From = Sim.LogLen;
+	CGUpload();
+	Done();
+	LogCount(From, &Cmds, &Data);
+	CHECK(Cmds == 2 && Data == 24);
+	CHECK(Sim.Log[From] == (H_SetCGRAMAdd|(1<<3)));
+	CHECK(Sim.Log[From+17] == (H_SetCGRAMAdd|(4<<3)));
+	CHECK(Sim.CGR[1*8+1] == 0x01);
+
+	//Nothing left to send.
+	From = Sim.LogLen;
+	CGUpload();
+	Done();
+	CHECK(Sim.LogLen == From);
+
+	//Only the cells showing slot 1 are stale.
+	CHECK(CGStaleCells(Cells, 8) == 2);
+	CHECK(Cells[0] == 0 && Cells[1] == H_XSize+3);
+
+	//ROM characters 0xF0 to 0xFF never count as custom
+	//ones, even after FBInvalidate (e.g. on a scroll).
+	//Invalidated cells are left to the next flush.
+	PChar((char)0xFE, 5, 1);
+	FBFlush();
+	Done();
+	CHECK(CGStaleCells(Cells, 8) == 2);
+	FBInvalidate();
+	CHECK(CGStaleCells(Cells, 8) == 0);
+	FBFlush();
+	Done();
+	CHECK(CGStaleCells(Cells, 8) == 2);
+	CHECK(Cells[0] == 0 && Cells[1] == H_XSize+3);
+	CHECK(FBShown());
+
+	CGPin(H_CGCode(3), 0);
+	CHECK(Sim.BusyErrs == 0);
+	H_SetTarget(H_TargetLCD);
+}
+
+//Each frame step of an animation rewrites its slot:
+//one CGRAM address and 8 rows.
+static void TestCGAnim(void){
+	static const uint8_t Frames[3][8] = {{0x1F, 0, 0, 0, 0, 0, 0, 0}, {0, 0x1F, 0, 0, 0, 0, 0, 0}, {0, 0, 0x1F, 0, 0, 0, 0, 0}};
+	uint8_t Ms, Step, Cmds, Data, Slot;
+	uint16_t From;
+	H_Anim A;
+	int8_t C;
+
+	Start(1, 0);
+	CGInit();
+
+	C = CGAnimStart(&A, Frames, 3, 10);
+	CHECK(C>=0);
+	Slot = C&7;
+	CGUpload();
+	Done();
+	CHECK(Sim.CGR[Slot*8] == 0x1F);
+
+	for(Step = 1; Step<=4; Step++){
+		for(Ms = 0; Ms<10; Ms++){
+			CGAnimTick();
+		}
+
+		From = Sim.LogLen;
+		CGUpload();
+		Done();
+		LogCount(From, &Cmds, &Data);
+		CHECK(Cmds == 1 && Data == 8);
+		CHECK(Sim.Log[From] == (H_SetCGRAMAdd|(Slot<<3)));
+		CHECK(Sim.CGR[Slot*8+Step%3] == 0x1F);
+	}
+
+	//No frame due, nothing sent.
+	From = Sim.LogLen;
+	CGAnimTick();
+	CGUpload();
+	Done();
+	CHECK(Sim.LogLen == From);
+
+	CGAnimStop(C);
+	CHECK(Sim.BusyErrs == 0);
+}
+
+//Canvas pixels only resend the tiles they're in, one
+//slot upload per changed tile, consecutive tiles
+//sharing the CGRAM address.
+static void TestCanvas(void){
+	uint8_t Cmds, Data;
+	uint16_t From;
+
+	Start(1, 0);
+	CGInit();
+	CHECK(CvInit(0, 1) == 0);
+	Done();
+	CHECK(Sim.DD[0x00] == H_CGCode(0) && Sim.DD[0x43] == H_CGCode(7));
+
+	CvPixel(0, 0, 1);
+	From = Sim.LogLen;
+	CvFlush();
+	Done();
+	LogCount(From, &Cmds, &Data);
+	CHECK(Cmds == 1 && Data == 8);
+	CHECK(Sim.CGR[0] == 0x10);
+
+	//Tiles 1 and 2 (consecutive slots) and tile 5.
+	CvPixel(5, 0, 1);
+	CvPixel(14, 7, 1);
+	CvPixel(9, 8, 1);
+	From = Sim.LogLen;
+	CvFlush();
+	Done();
+	LogCount(From, &Cmds, &Data);
+	CHECK(Cmds == 2 && Data == 24);
+	CHECK(Sim.CGR[1*8] == 0x10 && Sim.CGR[2*8+7] == 0x01 && Sim.CGR[5*8] == 0x01);
+
+	//Setting a pixel that's already set changes
+	//nothing.
+	CvPixel(0, 0, 1);
+	From = Sim.LogLen;
+	CvFlush();
+	Done();
+	CHECK(Sim.LogLen == From);
+	CHECK(Sim.BusyErrs == 0);
+}
+
+//A stopped animation's slot goes back to the cache, and
+//the characters still showing it are found stale once
+//it's reused.
+static void TestCGRelease(void){
+	static const uint8_t Frames[2][8] = {{1, 2, 3, 4, 5, 6, 7, 8}, {8, 7, 6, 5, 4, 3, 2, 1}};
+	uint8_t Glyph[8], Cells[4], N;
+	H_Anim A;
+	int8_t C;
+
+	Start(1, 0);
+	FBInit();
+	CGInit();
+	H_SetTarget(H_TargetFB);
+
+	C = CGAnimStart(&A, Frames, 2, 100);
+	CHECK(C>=0);
+	PChar(C, 3, 2);
+	CGUpload();
+	FBFlush();
+	Done();
+	CHECK(Sim.DD[0x43] == C);
+
+	CGAnimStop(C);
+	CHECK(CGStaleMask == 0);
+
+	//Fill every slot with new glyphs.
+	for(N = 0; N<H_CGSlots; N++){
+		TestGlyph(Glyph, N);
+		CHECK(CGGet(Glyph)>=0);
+	}
+	CGUpload();
+	Done();
+
+	CHECK(CGIsStale(C));
+	CHECK(CGStaleCells(Cells, 4) == 1);
+	CHECK(Cells[0] == H_XSize+3);
+
+	CGStaleClear();
+	CHECK(CGStaleCells(Cells, 4) == 0);
+	CHECK(Sim.BusyErrs == 0);
+	H_SetTarget(H_TargetLCD);
+}
+#endif
+
+int main(void){
+#ifdef HOST_GEO
+	H_SetGeometry(&HOST_GEO);
+#endif
+#ifdef H_USE_QUEUE
+	HostTimIRQ = H_QIRQHandler;
+#endif
+
+	TestInit();
+	TestPrint();
+	TestThroughput();
+	TestFields();
+	TestBlankTime();
+	TestScroll();
+	TestMarquee();
+	TestSelDisp();
+#ifdef H_USE_QUEUE
+	TestQueue();
+#endif
+#ifdef H_USE_FB
+	TestFBInit();
+	TestFBScroll();
+	TestFBFlushN();
+	TestFBPlanner();
+	TestFBEntryMode();
+	TestFBCommit();
+	TestFBBlink();
+	TestFBRegions();
+#endif
+#ifdef H_USE_DMA
+	TestDMA();
+#endif
+#ifdef H_USE_CG
+	TestBigNum();
+	TestBar();
+	TestCGCache();
+	TestCGAnim();
+	TestCanvas();
+	TestCGRelease();
+#endif
+
+	if(Fails) printf("%d check(s) failed\n", Fails);
+	return Fails?1:0;
+}
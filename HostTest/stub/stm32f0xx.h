@@ -0,0 +1,128 @@
+#ifndef STM32F0XX_H
+#define STM32F0XX_H
+
+#include <stdint.h>
+
+/*
+ * stm32f0xx.h (host)
+ *
+ *Stand in for the STM32F0 device header and standard
+ *peripheral library, just enough of them for the HD44780
+ *library to build on a PC. Peripherals are plain structs
+ *reached through HostPort and HostSysTick (HostHW.c), so
+ *every access lets the simulated controller catch up
+ *with the pins in program order.
+ *
+ *The code is released under the MIT License, see
+ *HD44780LIB.c for the full license text.
+ */
+
+typedef enum {DISABLE = 0, ENABLE = !DISABLE} FunctionalState;
+typedef enum {Bit_RESET = 0, Bit_SET} BitAction;
+
+//GPIO port. Writes to BSRR and BRR are applied to ODR
+//on the next access, IDR follows the output pins and
+//whatever the simulated controller drives on the
+//input pins. OutMask has the pins ever configured as
+//outputs.
+typedef struct{
+	volatile uint16_t IDR;
+	volatile uint16_t ODR;
+	volatile uint32_t BSRR;
+	volatile uint16_t BRR;
+	uint16_t InMask;
+	uint16_t OutMask;
+} GPIO_TypeDef;
+
+typedef enum {GPIO_Mode_IN = 0, GPIO_Mode_OUT = 1} GPIOMode_TypeDef;
+typedef enum {GPIO_OType_PP = 0, GPIO_OType_OD = 1} GPIOOType_TypeDef;
+typedef enum {GPIO_PuPd_NOPULL = 0, GPIO_PuPd_UP = 1, GPIO_PuPd_DOWN = 2} GPIOPuPd_TypeDef;
+typedef enum {GPIO_Speed_Level_1 = 1, GPIO_Speed_Level_2 = 2, GPIO_Speed_Level_3 = 3} GPIOSpeed_TypeDef;
+
+typedef struct{
+	uint32_t GPIO_Pin;
+	GPIOMode_TypeDef GPIO_Mode;
+	GPIOSpeed_TypeDef GPIO_Speed;
+	GPIOOType_TypeDef GPIO_OType;
+	GPIOPuPd_TypeDef GPIO_PuPd;
+} GPIO_InitTypeDef;
+
+GPIO_TypeDef* HostPort(uint8_t);
+#define GPIOA HostPort(0)
+#define GPIOB HostPort(1)
+
+void GPIO_Init(GPIO_TypeDef*, GPIO_InitTypeDef*);
+void GPIO_SetBits(GPIO_TypeDef*, uint16_t);
+void GPIO_ResetBits(GPIO_TypeDef*, uint16_t);
+void GPIO_WriteBit(GPIO_TypeDef*, uint16_t, BitAction);
+uint16_t GPIO_ReadInputData(GPIO_TypeDef*);
+uint8_t GPIO_ReadInputDataBit(GPIO_TypeDef*, uint16_t);
+
+//Clocks, nothing to do on the host.
+#define RCC_AHBPeriph_GPIOA		0x00020000
+#define RCC_AHBPeriph_GPIOB		0x00040000
+#define RCC_AHBPeriph_DMA1		0x00000001
+#define RCC_APB1Periph_TIM2		0x00000001
+#define RCC_APB1Periph_TIM14	0x00000100
+void RCC_AHBPeriphClockCmd(uint32_t, FunctionalState);
+void RCC_APB1PeriphClockCmd(uint32_t, FunctionalState);
+
+//SysTick, its current value follows the simulated
+//time.
+typedef struct{
+	volatile uint32_t CTRL;
+	volatile uint32_t LOAD;
+	volatile uint32_t VAL;
+	volatile uint32_t CALIB;
+} SysTick_Type;
+
+SysTick_Type* HostSysTick(void);
+#define SysTick HostSysTick()
+extern uint32_t SystemCoreClock;
+
+//Timer, DMA and NVIC, only stored, except for TIM14
+//(see HostTim14) which counts in simulated time and
+//runs its update interrupt.
+typedef struct{
+	volatile uint32_t CR1, DIER, SR, EGR, CNT, PSC, ARR;
+} TIM_TypeDef;
+
+typedef struct{
+	volatile uint32_t CCR, CNDTR, CPAR, CMAR;
+} DMA_Channel_TypeDef;
+
+typedef struct{
+	volatile uint32_t ISR, IFCR;
+} DMA_TypeDef;
+
+extern TIM_TypeDef HostTIM2;
+extern DMA_Channel_TypeDef HostDMA1Ch2;
+extern DMA_TypeDef HostDMA1;
+TIM_TypeDef* HostTim14(void);
+#define TIM2 (&HostTIM2)
+#define TIM14 HostTim14()
+#define DMA1_Channel2 (&HostDMA1Ch2)
+#define DMA1 (&HostDMA1)
+
+#define TIM_CR1_CEN			0x0001
+#define TIM_DIER_UIE		0x0001
+#define TIM_DIER_UDE		0x0100
+#define TIM_SR_UIF			0x0001
+#define TIM_EGR_UG			0x0001
+#define DMA_CCR_EN			0x0001
+#define DMA_CCR_TCIE		0x0002
+#define DMA_CCR_DIR			0x0010
+#define DMA_CCR_MINC		0x0080
+#define DMA_CCR_PSIZE_1		0x0200
+#define DMA_CCR_MSIZE_1		0x0800
+#define DMA_ISR_TCIF2		0x0020
+#define DMA_IFCR_CTCIF2		0x0020
+
+//Waiting for an interrupt lets simulated time pass.
+void HostIdle(void);
+#define H_Idle() HostIdle()
+
+typedef enum {DMA1_Channel2_3_IRQn = 10, TIM14_IRQn = 19} IRQn_Type;
+void NVIC_EnableIRQ(IRQn_Type);
+
+#endif
@@ -0,0 +1 @@
+#include "stm32f0xx.h"
@@ -1,7 +1,9 @@
 #include <HD44780LIB.h>
 
-//Timekeeping variable
+//Timekeeping variables, milliseconds and SysTick
+//interrupts (0.5ms)
 volatile uint32_t MSec = 0;
+volatile uint32_t STicks = 0;
 
 //Millisecond counter interrupt using
 //the internal SysTick timer
@@ -24,8 +26,26 @@ void SysTick_Handler(void){
 
 	MState^=1;
 	if(MState == 1) MSec++;
+	STicks++;
 }
 
+#ifdef BENCHMARK
+//Microsecond timestamp from the SysTick interrupt count
+//and the SysTick current value, for timing things
+//shorter than a millisecond.
+uint32_t Micros(void){
+	uint32_t T, Val;
+
+	//Read again if the interrupt ran in between.
+	do{
+		T = STicks;
+		Val = SysTick->VAL;
+	}while(T != STicks);
+
+	return T*500+(SysTick->LOAD-Val)/(SystemCoreClock/1000000);
+}
+#endif
+
 //Standard delay function! Executes the
 //nop instruction until T milliseconds have
 //passed.
@@ -34,7 +54,7 @@ void Delay(uint32_t T){
 	while((MSec-MSS)<T) asm volatile("nop");
 }
 
-//L main loop!
+//L� main loop!
 int main(void)
 {
 	//Setup the Systick timer for 0.5ms interrupts.
@@ -46,10 +66,11 @@ int main(void)
 	//If bouncing text is enabled, disable the blinking
 	//cursor. Otherwise, enable the blinking cursor.
 #ifdef BOUNCING_TEXT
-	H_W8b(H_DispCtrl|H_DispOn|H_CursorOff|H_CursrPosNBlnk, 0);
+	H_Put(H_DispCtrl|H_DispOn|H_CursorOff|H_CursrPosNBlnk, 0);
 
-	//Initial variables for bouncing text
-	uint8_t X = 0, Y = 1;
+	//Initial variables for bouncing text, the text
+	//bounces along the second row.
+	uint8_t X = 0, Y = 2;
 
 	//An XDir of 1 means the text is moving forward!
 	int8_t XDir = 1;
@@ -57,6 +78,120 @@ int main(void)
 	int32_t N, P = 0;
 #endif
 
+#ifdef BENCHMARK
+	//Rewrite the whole screen 20 times, timing it with
+	//the millisecond counter.
+	uint32_t BTime;
+	uint8_t BCnt;
+
+	MSec = 0;
+	for(BCnt = 0; BCnt<20; BCnt++){
+		PStr("0123456789ABCDEF", 0, 1);
+		PStr("FEDCBA9876543210", 0, 2);
+	}
+#ifdef H_USE_QUEUE
+	H_QFlush();
+#endif
+	BTime = MSec;
+	if(BTime == 0) BTime = 1;
+
+	//Display the bus mode and characters per second.
+	ClrDisp();
+	PStr(H_BusName, 0, 1);
+	PNum((20*2*H_XSize*1000)/BTime, 0, 2, 0);
+	PStr("ch/s", 11, 2);
+	Delay(4000);
+	ClrDisp();
+
+#ifndef H_BUS8B
+	//Time putting 64 nibbles and RS onto the pins the
+	//old way, a library call per pin, against the
+	//single BSRR store H_W8b uses now. The enable pin
+	//is left low so the display ignores the pins.
+	//SysTick counts core clock cycles, 64 nibbles the
+	//old way fit well within its 0.5ms period. The
+	//interrupts are held off so only the writes (and
+	//the loop) are counted.
+	uint32_t BLast, BOld, BNew;
+	uint8_t BNib;
+
+	__disable_irq();
+	BLast = SysTick->VAL;
+	for(BNib = 0; BNib<64; BNib++){
+		GPIO_WriteBit(HD44780_GPIO, H_RS, Bit_SET);
+		GPIO_WriteBit(HD44780_GPIO, H_D4, (BitAction)((BNib>>3)&1));
+		GPIO_WriteBit(HD44780_GPIO, H_D3, (BitAction)((BNib>>2)&1));
+		GPIO_WriteBit(HD44780_GPIO, H_D2, (BitAction)((BNib>>1)&1));
+		GPIO_WriteBit(HD44780_GPIO, H_D1, (BitAction)(BNib&1));
+	}
+	BOld = H_TicksSince(&BLast);
+
+	for(BNib = 0; BNib<64; BNib++){
+		HD44780_GPIO->BSRR = H_NibBSRR(BNib)|H_RS;
+	}
+	BNew = H_TicksSince(&BLast);
+	__enable_irq();
+
+	//Display the cycles per nibble both ways.
+	PStr("Lib cyc/nib", 0, 1);
+	PNum(BOld/64, 12, 1, 0);
+	PStr("BSRR cyc/nib", 0, 2);
+	PNum(BNew/64, 13, 2, 0);
+	Delay(4000);
+	ClrDisp();
+#endif
+
+	//Compare 20 updates of a changing number using the
+	//clear then redraw pattern against overwriting the
+	//field in place. With the clear, the number is
+	//blank or part drawn from the clear until it has
+	//been redrawn, BBlank adds up those windows.
+	//Overwriting replaces each character with the new
+	//one so the number is never blank (HostTest
+	//measures both on the simulated display).
+	uint32_t BClr, BOvr, BBlank = 0, BStart;
+	float BNum = 1.01f;
+
+	MSec = 0;
+	for(BCnt = 0; BCnt<20; BCnt++){
+		BStart = Micros();
+		ClrDisp();
+		PNumF(BNum, 0, 1, 3);
+#ifdef H_USE_QUEUE
+		H_QFlush();
+#endif
+		BBlank += Micros()-BStart;
+		BNum*=-1.05f;
+	}
+	BClr = MSec;
+
+	MSec = 0;
+	for(BCnt = 0; BCnt<20; BCnt++){
+		PNumFW(BNum, 0, 1, 3, H_XSize);
+		BNum*=-1.05f;
+	}
+#ifdef H_USE_QUEUE
+	H_QFlush();
+#endif
+	BOvr = MSec;
+
+	//Display the time taken for 20 updates in ms.
+	ClrDisp();
+	PStr("Clr ms", 0, 1);
+	PNum(BClr, 10, 1, 0);
+	PStr("Ovr ms", 0, 2);
+	PNum(BOvr, 10, 2, 0);
+	Delay(4000);
+
+	//Display the time the number was blank for with
+	//the clear, in us.
+	ClrDisp();
+	PStr("Clr blank us", 0, 1);
+	PNum(BBlank, 0, 2, 0);
+	Delay(4000);
+	ClrDisp();
+#endif
+
 	Delay(1);
 
 	//Print the string to the screen at 0,1!
@@ -83,13 +218,22 @@ int main(void)
 	//Reset millisecond counter!
 	MSec = 0;
 
+#ifdef BOUNCING_TEXT
+	//Print the hello world string once, it's moved
+	//with display shifts from now on.
+	PStr("Hello world!", X, Y);
+#endif
+
 	float FloatNum = 1.01f;
 	while(1)
 	{
 		//If bouncing text is defined, run the bouncing text
 		//otherwise, do nothing!
 #ifdef BOUNCING_TEXT
-		//Increment the X variable by "XDir" amount
+		//Shift the display by "XDir" columns, a single
+		//instruction instead of clearing and reprinting,
+		//and increment the X variable to match.
+		H_Scroll(XDir);
 		X+=XDir;
 
 		//If X has reached the screen boundaries,
@@ -99,12 +243,6 @@ int main(void)
 			XDir = -XDir;
 		}
 
-		//Clear the display
-		ClrDisp();
-
-		//Print the hello world string
-		PStr("Hello world!", X, Y);
-
 		//Increment LED brightness for absolutely
 		//no reason! :)
 		LEDBrightness++;
@@ -120,9 +258,11 @@ int main(void)
 		//it will break my PNumF function as there will
 		//be no more room in a 32bit integer to calculate
 		//the decimal place!
-		PNumF(FloatNum, 0, 1, 3);
+		//The number is overwritten in place with the
+		//rest of the line blanked, so the display never
+		//needs clearing and doesn't flicker.
+		PNumFW(FloatNum, 0, 1, 3, H_XSize);
 		FloatNum*=-1.05f;
 		Delay(500);
-		ClrDisp();
 	}
 }